@@ -0,0 +1,541 @@
+#include "FEHLCD.h"
+#include "FEHUtility.h"
+#include "FEHImages.h"
+#include "FEHRandom.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <time.h>
+#include <vector>
+#include <zlib.h>
+
+/*
+Headless FEH backend. Compile it together with main.cpp and put this folder first on the include path:
+    g++ -O3 -pthread -Iheadless main.cpp headless/FEHHeadless.cpp -lz -o meteorite-dash
+Environment:
+    FEH_TOUCH_SCRIPT    touch script to play back (see below). The run ends when the script is used up
+    FEH_HEADLESS_DUMP   writes the last framebuffer to this PPM file when the run ends
+    FEH_HEADLESS_SEED   seed for Random
+Touch script format, one step per line, where polls is how many LCD.Touch calls the step lasts:
+    down <x> <y> <polls>
+    up <polls>
+*/
+
+/*
+Description: Bookkeeping shared by the headless libraries: the virtual clock, the touch script and the
+per-frame timing that is reported when the run ends. A frame is the work done between two Sleep calls
+Author: Andrew Popa
+*/
+namespace {
+struct TouchStep {
+    bool bDown;
+    int x, y, polls;
+};
+
+struct HeadlessState {
+    double virtualMSec;
+    double lastSleepReal;
+    unsigned long frames, updates;
+    double workTotal, workMin, workMax;
+    unsigned long long pixelsWritten;
+    std::vector<TouchStep> touchScript;
+    size_t touchStep;
+    int touchPolls;
+    bool bScriptLoaded;
+    bool bRealSleep;
+} state = {0, -1, 0, 0, 0, 1e9, 0, 0, std::vector<TouchStep>(), 0, 0, false, false};
+
+void Report() {
+    fprintf(stderr, "headless: %lu frames, %lu updates, %.0f virtual ms\n", state.frames, state.updates, state.virtualMSec);
+    if (state.frames > 1)
+        fprintf(stderr, "headless: work per frame avg %.4f ms, min %.4f ms, max %.4f ms\n",
+            state.workTotal * 1000 / (state.frames - 1), state.workMin * 1000, state.workMax * 1000);
+    fprintf(stderr, "headless: %llu pixels written\n", state.pixelsWritten);
+    const char *pDump = getenv("FEH_HEADLESS_DUMP");
+    if (pDump && !LCD.SaveFrame(pDump))
+        fprintf(stderr, "headless: could not write %s\n", pDump);
+}
+
+void LoadTouchScript() {
+    state.bScriptLoaded = true;
+    const char *pName = getenv("FEH_TOUCH_SCRIPT");
+    FILE *pFile = pName ? fopen(pName, "r") : NULL;
+    if (!pFile) {
+        fprintf(stderr, "headless: no touch script (set FEH_TOUCH_SCRIPT), ending run at first touch poll\n");
+        return;
+    }
+    char line[128];
+    while (fgets(line, sizeof(line), pFile)) {
+        TouchStep step = {false, 0, 0, 0};
+        if (sscanf(line, " down %d %d %d", &step.x, &step.y, &step.polls) == 3)
+            step.bDown = true;
+        else if (sscanf(line, " up %d", &step.polls) != 1)
+            continue;
+        if (step.polls > 0)
+            state.touchScript.push_back(step);
+    }
+    fclose(pFile);
+}
+
+//Glyphs of the 5x7 font, one byte per column with the top row in the lowest bit, for characters 32-126
+const unsigned char font5x7[95][5] = {
+    {0x00,0x00,0x00,0x00,0x00},{0x00,0x00,0x5F,0x00,0x00},{0x00,0x07,0x00,0x07,0x00},{0x14,0x7F,0x14,0x7F,0x14},
+    {0x24,0x2A,0x7F,0x2A,0x12},{0x23,0x13,0x08,0x64,0x62},{0x36,0x49,0x56,0x20,0x50},{0x00,0x08,0x07,0x03,0x00},
+    {0x00,0x1C,0x22,0x41,0x00},{0x00,0x41,0x22,0x1C,0x00},{0x2A,0x1C,0x7F,0x1C,0x2A},{0x08,0x08,0x3E,0x08,0x08},
+    {0x00,0x80,0x70,0x30,0x00},{0x08,0x08,0x08,0x08,0x08},{0x00,0x00,0x60,0x60,0x00},{0x20,0x10,0x08,0x04,0x02},
+    {0x3E,0x51,0x49,0x45,0x3E},{0x00,0x42,0x7F,0x40,0x00},{0x72,0x49,0x49,0x49,0x46},{0x21,0x41,0x49,0x4D,0x33},
+    {0x18,0x14,0x12,0x7F,0x10},{0x27,0x45,0x45,0x45,0x39},{0x3C,0x4A,0x49,0x49,0x31},{0x41,0x21,0x11,0x09,0x07},
+    {0x36,0x49,0x49,0x49,0x36},{0x46,0x49,0x49,0x29,0x1E},{0x00,0x00,0x14,0x00,0x00},{0x00,0x40,0x34,0x00,0x00},
+    {0x00,0x08,0x14,0x22,0x41},{0x14,0x14,0x14,0x14,0x14},{0x00,0x41,0x22,0x14,0x08},{0x02,0x01,0x59,0x09,0x06},
+    {0x3E,0x41,0x5D,0x59,0x4E},{0x7C,0x12,0x11,0x12,0x7C},{0x7F,0x49,0x49,0x49,0x36},{0x3E,0x41,0x41,0x41,0x22},
+    {0x7F,0x41,0x41,0x41,0x3E},{0x7F,0x49,0x49,0x49,0x41},{0x7F,0x09,0x09,0x09,0x01},{0x3E,0x41,0x41,0x51,0x73},
+    {0x7F,0x08,0x08,0x08,0x7F},{0x00,0x41,0x7F,0x41,0x00},{0x20,0x40,0x41,0x3F,0x01},{0x7F,0x08,0x14,0x22,0x41},
+    {0x7F,0x40,0x40,0x40,0x40},{0x7F,0x02,0x1C,0x02,0x7F},{0x7F,0x04,0x08,0x10,0x7F},{0x3E,0x41,0x41,0x41,0x3E},
+    {0x7F,0x09,0x09,0x09,0x06},{0x3E,0x41,0x51,0x21,0x5E},{0x7F,0x09,0x19,0x29,0x46},{0x26,0x49,0x49,0x49,0x32},
+    {0x03,0x01,0x7F,0x01,0x03},{0x3F,0x40,0x40,0x40,0x3F},{0x1F,0x20,0x40,0x20,0x1F},{0x3F,0x40,0x38,0x40,0x3F},
+    {0x63,0x14,0x08,0x14,0x63},{0x03,0x04,0x78,0x04,0x03},{0x61,0x59,0x49,0x4D,0x43},{0x00,0x7F,0x41,0x41,0x41},
+    {0x02,0x04,0x08,0x10,0x20},{0x00,0x41,0x41,0x41,0x7F},{0x04,0x02,0x01,0x02,0x04},{0x40,0x40,0x40,0x40,0x40},
+    {0x00,0x03,0x07,0x08,0x00},{0x20,0x54,0x54,0x78,0x40},{0x7F,0x28,0x44,0x44,0x38},{0x38,0x44,0x44,0x44,0x28},
+    {0x38,0x44,0x44,0x28,0x7F},{0x38,0x54,0x54,0x54,0x18},{0x00,0x08,0x7E,0x09,0x02},{0x18,0xA4,0xA4,0x9C,0x78},
+    {0x7F,0x08,0x04,0x04,0x78},{0x00,0x44,0x7D,0x40,0x00},{0x20,0x40,0x40,0x3D,0x00},{0x7F,0x10,0x28,0x44,0x00},
+    {0x00,0x41,0x7F,0x40,0x00},{0x7C,0x04,0x78,0x04,0x78},{0x7C,0x08,0x04,0x04,0x78},{0x38,0x44,0x44,0x44,0x38},
+    {0xFC,0x18,0x24,0x24,0x18},{0x18,0x24,0x24,0x18,0xFC},{0x7C,0x08,0x04,0x04,0x08},{0x48,0x54,0x54,0x54,0x24},
+    {0x04,0x04,0x3F,0x44,0x24},{0x3C,0x40,0x40,0x20,0x7C},{0x1C,0x20,0x40,0x20,0x1C},{0x3C,0x40,0x30,0x40,0x3C},
+    {0x44,0x28,0x10,0x28,0x44},{0x4C,0x90,0x90,0x90,0x7C},{0x44,0x64,0x54,0x4C,0x44},{0x00,0x08,0x36,0x41,0x00},
+    {0x00,0x00,0x77,0x00,0x00},{0x00,0x41,0x36,0x08,0x00},{0x02,0x01,0x02,0x04,0x02}
+};
+}
+
+//Defined after the bookkeeping so it still exists when the report runs at exit
+FEHLCD LCD;
+FEHRandom Random;
+
+/* ---------------- FEHUtility ---------------- */
+
+void Sleep(int msec) {
+    double now = TimeNowReal();
+    if (state.lastSleepReal >= 0) {
+        double work = now - state.lastSleepReal;
+        state.workTotal += work;
+        if (work < state.workMin) state.workMin = work;
+        if (work > state.workMax) state.workMax = work;
+    }
+    state.frames++;
+    if (msec > 0)
+        state.virtualMSec += msec;
+    //The real wait is not counted as work, the next frame starts after it
+    if (state.bRealSleep && msec > 0) {
+        timespec wait = {msec / 1000, (msec % 1000) * 1000000L};
+        nanosleep(&wait, NULL);
+    }
+    state.lastSleepReal = TimeNowReal();
+}
+
+void Sleep(float sec) { Sleep((int)(sec * 1000)); }
+void Sleep(double sec) { Sleep((int)(sec * 1000)); }
+double TimeNow() { return state.virtualMSec / 1000; }
+unsigned int TimeNowSec() { return (unsigned int)(state.virtualMSec / 1000); }
+unsigned int TimeNowMSec() { return (unsigned int)state.virtualMSec; }
+void ResetTime() { state.virtualMSec = 0; }
+void SetRealSleep(bool bReal) { state.bRealSleep = bReal; }
+
+double TimeNowReal() {
+    timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+/* ---------------- FEHRandom ---------------- */
+
+FEHRandom::FEHRandom() {
+    const char *pSeed = getenv("FEH_HEADLESS_SEED");
+    Seed(pSeed ? (unsigned int)strtoul(pSeed, NULL, 10) : 1);
+}
+
+void FEHRandom::Seed() {
+    Seed((unsigned int)time(NULL));
+}
+
+void FEHRandom::Seed(unsigned int seed) {
+    state = seed;
+}
+
+int FEHRandom::RandInt() {
+    state = state * 1103515245u + 12345u;
+    return (state >> 16) & 0x7FFF;
+}
+
+/* ---------------- FEHLCD ---------------- */
+
+FEHLCD::FEHLCD() {
+    fontColor = ToNative(WHITE);
+    backgroundColor = ToNative(BLACK);
+    lastTouchX = lastTouchY = 0;
+    memset(frameBuffer, 0, sizeof(frameBuffer));
+    SetRenderTarget(NULL, 0, 0);
+    atexit(Report);
+}
+
+unsigned short FEHLCD::ToNative(unsigned int color) {
+    return (unsigned short)(((color >> 8) & 0xF800) | ((color >> 5) & 0x07E0) | ((color >> 3) & 0x001F));
+}
+
+unsigned int FEHLCD::FromNative(unsigned short pixel) {
+    unsigned int r = (pixel >> 11) & 0x1F, g = (pixel >> 5) & 0x3F, b = pixel & 0x1F;
+    return ((r << 3 | r >> 2) << 16) | ((g << 2 | g >> 4) << 8) | (b << 3 | b >> 2);
+}
+
+void FEHLCD::SetRenderTarget(unsigned short *pPixels, int width, int height) {
+    if (pPixels) {
+        pTarget = pPixels;
+        targetWidth = width;
+        targetHeight = height;
+    } else {
+        pTarget = &frameBuffer[0][0];
+        targetWidth = Width;
+        targetHeight = Height;
+    }
+}
+
+void FEHLCD::SetPixel(int x, int y, unsigned short color) {
+    if (x < 0 || x >= targetWidth || y < 0 || y >= targetHeight)
+        return;
+    pTarget[y * targetWidth + x] = color;
+    state.pixelsWritten++;
+}
+
+void FEHLCD::Span(int y, int x1, int x2, unsigned short color) {
+    if (x1 > x2) { int t = x1; x1 = x2; x2 = t; }
+    if (y < 0 || y >= targetHeight || x2 < 0 || x1 >= targetWidth)
+        return;
+    if (x1 < 0) x1 = 0;
+    if (x2 >= targetWidth) x2 = targetWidth - 1;
+    unsigned short *pRow = pTarget + y * targetWidth;
+    for (int x = x1; x <= x2; x++)
+        pRow[x] = color;
+    state.pixelsWritten += x2 - x1 + 1;
+}
+
+void FEHLCD::Clear(unsigned int color) {
+    unsigned short native = ToNative(color);
+    for (int y = 0; y < targetHeight; y++)
+        Span(y, 0, targetWidth - 1, native);
+}
+
+void FEHLCD::Clear() {
+    Clear(FromNative(backgroundColor));
+}
+
+void FEHLCD::SetFontColor(unsigned int color) { fontColor = ToNative(color); }
+void FEHLCD::SetBackgroundColor(unsigned int color) { backgroundColor = ToNative(color); }
+void FEHLCD::DrawPixel(int x, int y) { SetPixel(x, y, fontColor); }
+void FEHLCD::DrawHorizontalLine(int y, int x1, int x2) { Span(y, x1, x2, fontColor); }
+
+void FEHLCD::DrawVerticalLine(int x, int y1, int y2) {
+    if (y1 > y2) { int t = y1; y1 = y2; y2 = t; }
+    for (int y = y1; y <= y2; y++)
+        SetPixel(x, y, fontColor);
+}
+
+void FEHLCD::DrawLine(int x1, int y1, int x2, int y2) {
+    //Bresenham's line algorithm
+    int dx = abs(x2 - x1), sx = x1 < x2 ? 1 : -1;
+    int dy = -abs(y2 - y1), sy = y1 < y2 ? 1 : -1;
+    int err = dx + dy;
+    while (true) {
+        SetPixel(x1, y1, fontColor);
+        if (x1 == x2 && y1 == y2)
+            break;
+        int e2 = 2 * err;
+        if (e2 >= dy) { err += dy; x1 += sx; }
+        if (e2 <= dx) { err += dx; y1 += sy; }
+    }
+}
+
+void FEHLCD::DrawRectangle(int x, int y, int width, int height) {
+    DrawHorizontalLine(y, x, x + width);
+    DrawHorizontalLine(y + height, x, x + width);
+    DrawVerticalLine(x, y, y + height);
+    DrawVerticalLine(x + width, y, y + height);
+}
+
+void FEHLCD::FillRectangle(int x, int y, int width, int height) {
+    for (int row = y; row < y + height; row++)
+        Span(row, x, x + width - 1, fontColor);
+}
+
+void FEHLCD::DrawCircle(int x0, int y0, int r) {
+    //Midpoint circle algorithm
+    int x = r, y = 0, err = 1 - r;
+    while (x >= y) {
+        SetPixel(x0 + x, y0 + y, fontColor); SetPixel(x0 - x, y0 + y, fontColor);
+        SetPixel(x0 + x, y0 - y, fontColor); SetPixel(x0 - x, y0 - y, fontColor);
+        SetPixel(x0 + y, y0 + x, fontColor); SetPixel(x0 - y, y0 + x, fontColor);
+        SetPixel(x0 + y, y0 - x, fontColor); SetPixel(x0 - y, y0 - x, fontColor);
+        y++;
+        if (err < 0) {
+            err += 2 * y + 1;
+        } else {
+            x--;
+            err += 2 * (y - x) + 1;
+        }
+    }
+}
+
+void FEHLCD::FillCircle(int x0, int y0, int r) {
+    for (int dy = -r; dy <= r; dy++) {
+        int dx = (int)sqrt((double)(r * r - dy * dy));
+        Span(y0 + dy, x0 - dx, x0 + dx, fontColor);
+    }
+}
+
+void FEHLCD::WriteChar(char c, int x, int y) {
+    if (c < 32 || c > 126)
+        c = '?';
+    const unsigned char *pGlyph = font5x7[c - 32];
+    //Each 5x7 glyph is drawn at double size inside the 12x17 character cell
+    for (int col = 0; col < 5; col++)
+        for (int row = 0; row < 8; row++)
+            if (pGlyph[col] & (1 << row)) {
+                int px = x + 1 + col * 2, py = y + 1 + row * 2;
+                SetPixel(px, py, fontColor); SetPixel(px + 1, py, fontColor);
+                SetPixel(px, py + 1, fontColor); SetPixel(px + 1, py + 1, fontColor);
+            }
+}
+
+void FEHLCD::WriteAt(const char *str, int x, int y) {
+    for (int i = 0; str[i] != '\0'; i++)
+        WriteChar(str[i], x + i * 12, y);
+}
+
+void FEHLCD::WriteAt(int i, int x, int y) {
+    char text[16];
+    snprintf(text, sizeof(text), "%d", i);
+    WriteAt(text, x, y);
+}
+
+void FEHLCD::WriteAt(float f, int x, int y) {
+    WriteAt((double)f, x, y);
+}
+
+void FEHLCD::WriteAt(double d, int x, int y) {
+    char text[32];
+    snprintf(text, sizeof(text), "%.3f", d);
+    WriteAt(text, x, y);
+}
+
+bool FEHLCD::Touch(int *x, int *y) {
+    if (!state.bScriptLoaded)
+        LoadTouchScript();
+    if (state.touchStep >= state.touchScript.size()) {
+        fprintf(stderr, "headless: touch script finished\n");
+        exit(0);
+    }
+    const TouchStep &step = state.touchScript[state.touchStep];
+    if (step.bDown) {
+        lastTouchX = step.x;
+        lastTouchY = step.y;
+    }
+    if (++state.touchPolls >= step.polls) {
+        state.touchStep++;
+        state.touchPolls = 0;
+    }
+    //Like the touch screen, report the last touched position when there is no touch
+    *x = lastTouchX;
+    *y = lastTouchY;
+    return step.bDown;
+}
+
+bool FEHLCD::TouchScriptFinished() {
+    if (!state.bScriptLoaded)
+        LoadTouchScript();
+    return state.touchStep >= state.touchScript.size();
+}
+
+bool FEHLCD::Touch(float *x, float *y) {
+    int xTouch, yTouch;
+    bool bTouched = Touch(&xTouch, &yTouch);
+    *x = xTouch;
+    *y = yTouch;
+    return bTouched;
+}
+
+void FEHLCD::Update() {
+    state.updates++;
+}
+
+void FEHLCD::Blit(int x, int y, int width, int height, const unsigned short *pPixels, int stride) {
+    //Clip the block to the screen, moving the source pointer along with the clipped edges
+    if (x < 0) { pPixels -= x; width += x; x = 0; }
+    if (y < 0) { pPixels -= y * stride; height += y; y = 0; }
+    if (x + width > targetWidth) width = targetWidth - x;
+    if (y + height > targetHeight) height = targetHeight - y;
+    if (width <= 0 || height <= 0)
+        return;
+    for (int row = 0; row < height; row++)
+        memcpy(pTarget + (y + row) * targetWidth + x, pPixels + row * stride, width * sizeof(unsigned short));
+    state.pixelsWritten += (unsigned long long)width * height;
+}
+
+void FEHLCD::BlitMasked(int x, int y, int width, int height, const unsigned short *pPixels, int stride, unsigned short key) {
+    if (x < 0) { pPixels -= x; width += x; x = 0; }
+    if (y < 0) { pPixels -= y * stride; height += y; y = 0; }
+    if (x + width > targetWidth) width = targetWidth - x;
+    if (y + height > targetHeight) height = targetHeight - y;
+    for (int row = 0; row < height; row++) {
+        const unsigned short *pSource = pPixels + row * stride;
+        unsigned short *pDest = pTarget + (y + row) * targetWidth + x;
+        //Copy each run of non-key pixels in one go
+        int col = 0;
+        while (col < width) {
+            while (col < width && pSource[col] == key)
+                col++;
+            int start = col;
+            while (col < width && pSource[col] != key)
+                col++;
+            memcpy(pDest + start, pSource + start, (col - start) * sizeof(unsigned short));
+            state.pixelsWritten += col - start;
+        }
+    }
+}
+
+bool FEHLCD::SaveFrame(const char *fileName) const {
+    FILE *pFile = fopen(fileName, "wb");
+    if (!pFile)
+        return false;
+    fprintf(pFile, "P6\n%d %d\n255\n", (int)Width, (int)Height);
+    for (int y = 0; y < Height; y++)
+        for (int x = 0; x < Width; x++) {
+            unsigned int color = FromNative(frameBuffer[y][x]);
+            unsigned char rgb[3] = {(unsigned char)(color >> 16), (unsigned char)(color >> 8), (unsigned char)color};
+            fwrite(rgb, 1, 3, pFile);
+        }
+    fclose(pFile);
+    return true;
+}
+
+/* ---------------- FEHImage ---------------- */
+
+FEHImage::FEHImage() : width(0), height(0), pPixels(NULL), pOpaque(NULL) {}
+
+FEHImage::FEHImage(const char *filename) : width(0), height(0), pPixels(NULL), pOpaque(NULL) {
+    Open(filename);
+}
+
+FEHImage::~FEHImage() {
+    Close();
+}
+
+void FEHImage::Close() {
+    delete[] pPixels;
+    delete[] pOpaque;
+    pPixels = NULL;
+    pOpaque = NULL;
+    width = height = 0;
+}
+
+static unsigned int ReadBigEndian(const unsigned char *p) {
+    return (unsigned int)p[0] << 24 | (unsigned int)p[1] << 16 | (unsigned int)p[2] << 8 | p[3];
+}
+
+void FEHImage::Open(const char *filename) {
+    Close();
+    FILE *pFile = fopen(filename, "rb");
+    if (!pFile) {
+        fprintf(stderr, "headless: could not open image %s\n", filename);
+        return;
+    }
+    std::vector<unsigned char> file;
+    unsigned char buffer[4096];
+    size_t read;
+    while ((read = fread(buffer, 1, sizeof(buffer), pFile)) > 0)
+        file.insert(file.end(), buffer, buffer + read);
+    fclose(pFile);
+
+    static const unsigned char signature[8] = {137, 'P', 'N', 'G', 13, 10, 26, 10};
+    if (file.size() < 8 || memcmp(&file[0], signature, 8) != 0) {
+        fprintf(stderr, "headless: %s is not a PNG file\n", filename);
+        return;
+    }
+    //Walk the chunks, keeping the header fields and all of the compressed image data
+    int w = 0, h = 0, bitDepth = 0, colorType = 0, interlace = 0;
+    std::vector<unsigned char> compressed;
+    for (size_t pos = 8; pos + 8 <= file.size(); ) {
+        unsigned int length = ReadBigEndian(&file[pos]);
+        const unsigned char *pType = &file[pos + 4];
+        if (pos + 12 + length > file.size())
+            break;
+        const unsigned char *pData = &file[pos + 8];
+        if (memcmp(pType, "IHDR", 4) == 0) {
+            w = ReadBigEndian(pData);
+            h = ReadBigEndian(pData + 4);
+            bitDepth = pData[8];
+            colorType = pData[9];
+            interlace = pData[12];
+        } else if (memcmp(pType, "IDAT", 4) == 0) {
+            compressed.insert(compressed.end(), pData, pData + length);
+        } else if (memcmp(pType, "IEND", 4) == 0) {
+            break;
+        }
+        pos += 12 + length;
+    }
+    if (bitDepth != 8 || (colorType != 2 && colorType != 6) || interlace != 0 || w <= 0 || h <= 0) {
+        fprintf(stderr, "headless: %s must be an 8-bit RGB or RGBA non-interlaced PNG\n", filename);
+        return;
+    }
+    int channels = colorType == 6 ? 4 : 3;
+    size_t rowBytes = (size_t)w * channels;
+    std::vector<unsigned char> raw((rowBytes + 1) * h);
+    uLongf rawSize = raw.size();
+    if (uncompress(&raw[0], &rawSize, &compressed[0], compressed.size()) != Z_OK || rawSize != raw.size()) {
+        fprintf(stderr, "headless: could not decompress %s\n", filename);
+        return;
+    }
+
+    width = w;
+    height = h;
+    pPixels = new unsigned short[w * h];
+    pOpaque = new unsigned char[w * h];
+    std::vector<unsigned char> prev(rowBytes, 0), row(rowBytes);
+    for (int y = 0; y < h; y++) {
+        const unsigned char *pLine = &raw[y * (rowBytes + 1)];
+        int filter = pLine[0];
+        //Undo the PNG row filter, where a is the byte to the left, b above and c above-left
+        for (size_t i = 0; i < rowBytes; i++) {
+            int a = i >= (size_t)channels ? row[i - channels] : 0;
+            int b = prev[i];
+            int c = i >= (size_t)channels ? prev[i - channels] : 0;
+            int predictor = 0;
+            if (filter == 1) predictor = a;
+            else if (filter == 2) predictor = b;
+            else if (filter == 3) predictor = (a + b) / 2;
+            else if (filter == 4) {
+                int p = a + b - c, pa = abs(p - a), pb = abs(p - b), pc = abs(p - c);
+                predictor = (pa <= pb && pa <= pc) ? a : (pb <= pc ? b : c);
+            }
+            row[i] = (unsigned char)(pLine[1 + i] + predictor);
+        }
+        for (int x = 0; x < w; x++) {
+            const unsigned char *p = &row[x * channels];
+            pPixels[y * w + x] = FEHLCD::ToNative(p[0] << 16 | p[1] << 8 | p[2]);
+            pOpaque[y * w + x] = channels == 3 || p[3] >= 128;
+        }
+        prev.swap(row);
+    }
+}
+
+void FEHImage::Draw(int x, int y) {
+    //Draw opaque runs of each row as one block so the common fully opaque image is a row copy
+    for (int row = 0; row < height; row++) {
+        int col = 0;
+        while (col < width) {
+            while (col < width && !pOpaque[row * width + col])
+                col++;
+            int start = col;
+            while (col < width && pOpaque[row * width + col])
+                col++;
+            if (col > start)
+                LCD.Blit(x + start, y + row, col - start, 1, pPixels + row * width + start, width);
+        }
+    }
+}
@@ -0,0 +1,31 @@
+#ifndef FEHIMAGES_H
+#define FEHIMAGES_H
+
+/*
+Description: Headless replacement for the Proteus FEHImage class. Decodes 8-bit RGB/RGBA PNG files with zlib
+into the LCD's native RGB565 format. Pixels with alpha below 50% are transparent and are skipped by Draw()
+Author: Andrew Popa
+*/
+class FEHImage {
+    int width, height;
+    unsigned short *pPixels;
+    unsigned char *pOpaque;
+public:
+    FEHImage();
+    FEHImage(const char *filename);
+    ~FEHImage();
+    void Open(const char *filename);
+    void Draw(int x, int y);
+    void Close();
+
+    //Headless only: direct access to the decoded image
+    int Width() const { return width; }
+    int Height() const { return height; }
+    const unsigned short *Pixels() const { return pPixels; }
+    const unsigned char *Opaque() const { return pOpaque; }
+private:
+    FEHImage(const FEHImage &);
+    FEHImage &operator=(const FEHImage &);
+};
+
+#endif
@@ -0,0 +1,96 @@
+#ifndef FEHLCD_H
+#define FEHLCD_H
+
+#include <string.h>
+#include <stdint.h>
+
+/*
+Description: Headless replacement for the Proteus FEHLCD library. Everything is drawn into an in-memory
+320x240 RGB565 framebuffer instead of the screen, and touches come from a script file (FEH_TOUCH_SCRIPT)
+so the menus and Game() can be driven and benchmarked on Linux without the Proteus
+Author: Andrew Popa
+*/
+
+#define FEH_HEADLESS 1
+//The headless LCD can copy pixel blocks straight into the framebuffer (see Blit)
+#define FEHLCD_HAS_BLIT 1
+
+//Colors use the same 0xRRGGBB values as the Proteus library
+#define BLACK           0x000000
+#define WHITE           0xFFFFFF
+#define RED             0xFF0000
+#define DARKRED         0x8B0000
+#define ORANGERED       0xFF4500
+#define TOMATO          0xFF6347
+#define GOLDENROD       0xDAA520
+#define YELLOW          0xFFFF00
+#define YELLOWGREEN     0x9ACD32
+#define GREEN           0x008000
+#define TAN             0xD2B48C
+#define CYAN            0x00FFFF
+#define DARKTURQUOISE   0x00CED1
+#define BLUE            0x0000FF
+#define BLUEVIOLET      0x8A2BE2
+#define PURPLE          0x800080
+#define GRAY            0x808080
+#define LIGHTGRAY       0xD3D3D3
+#define DARKSLATEGRAY   0x2F4F4F
+#define LIGHTSLATEGRAY  0x778899
+
+class FEHLCD {
+    unsigned short frameBuffer[240][320];
+    //Where drawing goes: the framebuffer, or an offscreen image set with SetRenderTarget
+    unsigned short *pTarget;
+    int targetWidth, targetHeight;
+    unsigned short fontColor, backgroundColor;
+    int lastTouchX, lastTouchY;
+
+    void SetPixel(int x, int y, unsigned short color);
+    void Span(int y, int x1, int x2, unsigned short color);
+    void WriteChar(char c, int x, int y);
+public:
+    enum { Width = 320, Height = 240 };
+
+    FEHLCD();
+    void Clear(unsigned int color);
+    void Clear();
+    void SetFontColor(unsigned int color);
+    void SetBackgroundColor(unsigned int color);
+
+    void DrawPixel(int x, int y);
+    void DrawHorizontalLine(int y, int x1, int x2);
+    void DrawVerticalLine(int x, int y1, int y2);
+    void DrawLine(int x1, int y1, int x2, int y2);
+    void DrawRectangle(int x, int y, int width, int height);
+    void FillRectangle(int x, int y, int width, int height);
+    void DrawCircle(int x0, int y0, int r);
+    void FillCircle(int x0, int y0, int r);
+
+    void WriteAt(const char *str, int x, int y);
+    void WriteAt(int i, int x, int y);
+    void WriteAt(float f, int x, int y);
+    void WriteAt(double d, int x, int y);
+
+    bool Touch(int *x, int *y);
+    bool Touch(float *x, float *y);
+    //Headless only: true once the touch script is used up, when the next Touch ends the run
+    bool TouchScriptFinished();
+    void Update();
+
+    //Headless only: copy a width x height block of native pixels (stride pixels per row) to x, y
+    void Blit(int x, int y, int width, int height, const unsigned short *pPixels, int stride);
+    //Headless only: same as Blit, but pixels equal to key are skipped
+    void BlitMasked(int x, int y, int width, int height, const unsigned short *pPixels, int stride, unsigned short key);
+    //Headless only: send all drawing to a width x height offscreen image until called again with NULL
+    void SetRenderTarget(unsigned short *pPixels, int width, int height);
+    //Headless only: the framebuffer contents and the color conversion used for it
+    const unsigned short *FrameBuffer() const { return &frameBuffer[0][0]; }
+    static unsigned short ToNative(unsigned int color);
+    static unsigned int FromNative(unsigned short pixel);
+    //Headless only: writes the framebuffer to a binary PPM file
+    bool SaveFrame(const char *fileName) const;
+};
+
+extern FEHLCD LCD;
+
+#endif
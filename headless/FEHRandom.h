@@ -0,0 +1,20 @@
+#ifndef FEHRANDOM_H
+#define FEHRANDOM_H
+
+/*
+Description: Headless replacement for the Proteus FEHRandom library. RandInt() returns 0-32767 like the
+Proteus version. The sequence is fixed unless FEH_HEADLESS_SEED is set in the environment
+Author: Andrew Popa
+*/
+class FEHRandom {
+    unsigned int state;
+public:
+    FEHRandom();
+    void Seed();
+    void Seed(unsigned int seed);
+    int RandInt();
+};
+
+extern FEHRandom Random;
+
+#endif
@@ -0,0 +1,27 @@
+#ifndef FEHUTILITY_H
+#define FEHUTILITY_H
+
+/*
+Description: Headless replacement for the Proteus FEHUtility library. Time is virtual: Sleep() advances the
+clock instead of blocking, so the game loop runs as fast as the host CPU allows while still seeing the same
+timestamps it would on the Proteus
+Author: Andrew Popa
+*/
+
+#define FEH_HEADLESS 1
+
+void Sleep(int msec);
+void Sleep(float sec);
+void Sleep(double sec);
+double TimeNow();
+unsigned int TimeNowSec();
+unsigned int TimeNowMSec();
+void ResetTime();
+
+//Headless only: real (host) monotonic time in seconds, used to measure how long the code between Sleeps takes
+double TimeNowReal();
+
+//Headless only: when set, Sleep also waits for real, for loops that keep pace with a thread on the real clock
+void SetRealSleep(bool bReal);
+
+#endif
@@ -3,734 +3,5547 @@
 #include "FEHImages.h"
 #include "FEHRandom.h"
 #include "math.h"
+#include "stdio.h"
+#include "stdlib.h"
+#include "time.h"
+#include "tools/AtlasFormat.h"
+#ifdef FEH_HEADLESS
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+#endif
 
 #define CHAR_HEIGHT 17
 #define CHAR_WIDTH 12
 
-bool StartGameConfigure();
-int MapSelect();
-int SelectDifficulty();
-void ShowCredits();
-void ShowStats();
-void ShowInstructions();
-void Game(int mapType, int meteoriteCount);
+void RunScenes();
+class ReplayReader;
+void Game(int mapType, int meteoriteCount, unsigned int seed, ReplayReader *pReplay = NULL);
+unsigned int NewGameSeed();
+bool PlayReplay(const char *pFileName);
+#ifdef FEH_HEADLESS
+int RunBatch(int argc, char *argv[]);
+int RunReplay(int argc, char *argv[]);
+void ReportScenes();
+#endif
 //Last game duration in MS
 unsigned long gameDuration = 0;
 int meteoriteSurvived = 0;
-float gameSpeed = 0;
+//Seed of the last game, the same seed gives the same meteorites
+unsigned int gameSeed = 0;
+//When the tap that started the next game happened (0 once its first frame is drawn), and the time from that tap to
+//the last game's first frame in seconds
+double gameTapTime = 0;
+double firstFrameSeconds = 0;
+#ifdef FEH_HEADLESS
+//Set by --threaded: the game's simulation runs on its own thread, see PlayThreaded
+bool bThreadedGame = false;
+#endif
 
 /*
-Description:Class Button that creates an object button that is used to draw the button and check
-if the button has been clicked. Returns the button if clicked 
-Private: width, height, location, color, text color, text, image
-Public: Constructor, Deconstructor, DrawButton function, Clicked function
-Author: Andrew Popa 
+Description: Clock used for measurements. On the Proteus this is the normal clock, in the headless build the normal
+clock is virtual so the host clock is used to measure how long the code actually takes
+Input: N/A
+Output: Time in seconds
+Author: Andrew Popa
 */
-class Button {
-    int x, y, width, height, buttonColor, textColor;
-    char *text;
+double MeasureTime() {
+#ifdef FEH_HEADLESS
+    return TimeNowReal();
+#else
+    return TimeNow();
+#endif
+}
+
+#define MAX_ASSETS 16               //Number of different images the asset cache can hold
+#define ASSET_NAME_LENGTH 32        //Longest image file name the asset cache can hold
+#define ATLAS_FILE "assets.atlas"   //Atlas made by tools/AtlasPack.cpp, images missing from it are loaded from their PNG
+
+/*
+Description: Load time and memory statistics of the asset cache
+Author: Andrew Popa
+*/
+struct AssetStats {
+    int loads;              //Number of images decoded from a file
+    int atlasImages;        //Number of images served from the atlas
+    unsigned long hits;     //Number of requests answered without loading
+    double loadSeconds;     //Total time spent decoding images and loading the atlas
+    unsigned long bytes;    //Memory held by the decoded images and the atlas, 0 if the library does not tell
+};
+
+/*
+Description: Paints a block of RGB565 pixels without block copies: each row is split into runs of one colour, and
+each run longer than a pixel is drawn as one horizontal line, so a dark sky or a flat sand area costs one line
+instead of a pixel each
+Input: Top left x and y coordinate, width and height of the block, first pixel, distance between rows, true to skip
+ATLAS_KEY pixels
+Output: N/A, changes the font colour
+Author: Andrew Popa
+*/
+void PaintRuns(int x, int y, int width, int height, const unsigned short *pPixels, int stride, bool bMasked) {
+    for (int row = 0; row < height; row++) {
+        const unsigned short *pRow = pPixels + row * stride;
+        for (int start = 0; start < width; ) {
+            unsigned short pixel = pRow[start];
+            int end = start + 1;
+            while (end < width && pRow[end] == pixel)
+                end++;
+            if (!bMasked || pixel != ATLAS_KEY) {
+                unsigned int r = (pixel >> 11) & 0x1F, g = (pixel >> 5) & 0x3F, b = pixel & 0x1F;
+                LCD.SetFontColor(((r << 3 | r >> 2) << 16) | ((g << 2 | g >> 4) << 8) | (b << 3 | b >> 2));
+                if (end - start == 1)
+                    LCD.DrawPixel(x + start, y + row);
+                else
+                    LCD.DrawHorizontalLine(y + row, x + start, x + end - 1);
+            }
+            start = end;
+        }
+    }
+}
+
+/*
+Description: An image handed out by the asset cache: either a decoded PNG or an area of the texture atlas
+Private: decoded image (NULL for atlas areas), pixels, size, distance between rows and whether some pixels are
+transparent. A PNG decoded by the stock library has no pixels, since it does not give them out
+Public: Constructors, Deconstructor, Draw function, Pixels function, Stride function, Width function, Height function
+Author: Andrew Popa
+*/
+class Asset {
     FEHImage *pImage;
-public: 
+    const unsigned short *pPixels;
+    int width, height, stride;
+    bool bMasked;
+public:
     /*
-    Description: Constructor that initializes the values for the button
-    Input: Top left x and y coordinate, height and width, button color, text to display, and image to display
+    Description: Constructor for a decoded PNG, which the asset takes ownership of
+    Input: Decoded image
     Output: N/A
     Author: Andrew Popa
     */
-    Button (int _x, int _y, int _width, int _height, int _buttonColor, int _textColor, char* _text, char* imageName = NULL) {
-        x = _x;
-        y = _y;
-        width = _width;
-        height = _height;
-        buttonColor = _buttonColor;
-        textColor = _textColor;
-        text = _text;
-        //Inline if checking if the passed pointer for the image is null or not, and creating an image object if not NULL 
-        pImage =  imageName ? new FEHImage(imageName) : NULL;
+    Asset (FEHImage *_pImage) {
+        pImage = _pImage;
+#ifdef FEHLCD_HAS_BLIT
+        pPixels = pImage->Pixels();
+        width = stride = pImage->Width();
+        height = pImage->Height();
+#else
+        pPixels = NULL;
+        width = stride = height = 0;
+#endif
+        bMasked = false;
     }
+
     /*
-    Description: Deconstructor that destroys image object because it remains in memeory and it is not deleted when object is deleted.
-    When the object is destroyed, the pointer to the image is destroyed and not the image so the deconstructor must be 
-    used to ensure the image object is destroyed, to free memory.
-    Input: N/A
+    Description: Constructor for an area of the atlas
+    Input: First pixel of the area, size, distance between rows, whether ATLAS_KEY pixels are transparent
     Output: N/A
     Author: Andrew Popa
     */
-    ~Button () {
-        if (pImage)
-            delete pImage;
+    Asset (const unsigned short *_pPixels, int _width, int _height, int _stride, bool _bMasked) {
+        pImage = NULL;
+        pPixels = _pPixels;
+        width = _width;
+        height = _height;
+        stride = _stride;
+        bMasked = _bMasked;
     }
+
     /*
-    Description: Draws out the button with the given parameters passed when the Button object is called
+    Description: Deconstructor that frees the decoded image, atlas areas belong to the atlas
     Input: N/A
-    Output: N/A, just displays to screen
+    Output: N/A
     Author: Andrew Popa
     */
-    void DrawButton() {
-        //If the pointer to the image is not NULL, then draw the image in the coordinates shown
-        if (pImage) 
-            //x + 1 and y + 1, because the border takes a pixel
-            pImage->Draw(x + 1, y + 1);
-        LCD.SetFontColor(buttonColor);
-        LCD.DrawRectangle(x, y, width, height);
-        LCD.SetFontColor(textColor);
-        /*Takes the length of the box and the length of the text and then subtracts them from each other, and divides
-        this length by 2 to determine the distance between the centered text and the edge of the box, writing the text
-        at the start of this margin*/
-        LCD.WriteAt(text, x + (width - (strlen(text)*CHAR_WIDTH)) / 2, y + 2 + (height-CHAR_HEIGHT) / 2);
+    ~Asset () {
+        delete pImage;
     }
+
     /*
-    Description: Checks if the inputted values match with were a button was clicked.
-    Input: X and Y coordinates of the click
-    Output: True if clicked inside of the button it was called on
+    Description: Draws the image with its top left corner at x, y
+    Input: x and y coordinate
+    Output: N/A
     Author: Andrew Popa
     */
-    bool Clicked(int xClick, int yClick) {
-        return xClick > x && xClick < x + width && yClick > y && yClick < y + height;
+    void Draw(int x, int y) {
+        if (!pImage) {
+#ifdef FEHLCD_HAS_BLIT
+            if (bMasked)
+                LCD.BlitMasked(x, y, width, height, pPixels, stride, ATLAS_KEY);
+            else
+                LCD.Blit(x, y, width, height, pPixels, stride);
+#else
+            PaintRuns(x, y, width, height, pPixels, stride, bMasked);
+#endif
+            return;
+        }
+        pImage->Draw(x, y);
     }
+
+    const unsigned short *Pixels() { return pPixels; }
+    int Stride() { return stride; }
+    int Width() { return width; }
+    int Height() { return height; }
 };
 
 /*
-Description: Cycles through an array of objects of type Button and calls the DrawButton function
-Input: Array of pointers to each Button
-Output: N/A just draws the buttons
+Description: Texture atlas file loaded with one call: memory mapped in the headless build, read with a single
+fread otherwise. Its images are already in the LCD's pixel format, so they are drawn straight from it
+Private: file contents, size, whether it is mapped, header, entries, pixels
+Public: Constructor, Deconstructor, Load function, IsLoaded function, Entry function, Find function, Size function
 Author: Andrew Popa
 */
-void DrawButtons(Button *pButtons[]) {
-    for (int i = 0; pButtons[i] != NULL; i++)
-        pButtons[i]->DrawButton();
-}
+class TextureAtlas {
+    unsigned char *pData;
+    unsigned long size;
+    bool bMapped;
+    const AtlasHeader *pHeader;
+    const AtlasEntry *pEntries;
+    const unsigned short *pPixels;
 
-/*
-Description: Function checks if a button was clicked, and returns the button that was clicked
-Input: Array of pointers to Buttons, bool if previous instance the button was pressed (used to check if released)
-Output: button that was pressed
-Author: Andrew Popa
-*/
-Button* CheckButtonsClick(Button *pButtons[], bool bWaitForClick) {
-    Button *pReturnButtons = NULL;
+    /*
+    Description: Frees or unmaps the file contents
+    Input: N/A
+    Output: N/A
+    Author: Andrew Popa
+    */
+    void Unload() {
+#ifdef FEH_HEADLESS
+        if (bMapped)
+            munmap(pData, size);
+        else
+#endif
+            delete[] pData;
+        pData = NULL;
+        pHeader = NULL;
+        bMapped = false;
+    }
 
-    do {
-        int x, y;
-        static bool bPrevBtnPress = false;
-        static int touchX = INT32_MAX, touchY = INT32_MAX;
-        //Initial press recorded
-        bool bCurrBtnPress = LCD.Touch(&x, &y);
-        //If user just pressed the finger, record the press location
-        if (bPrevBtnPress == false && bCurrBtnPress == true) {
-            touchX = x;
-            touchY = y;
-        } else
-        //If user just lifted the finger
-        if (bPrevBtnPress == true && bCurrBtnPress == false) {
-            //Check if any buttons was clicked when the finger was lifted
-            for(int i = 0; pButtons[i] != NULL; i++) {
-                //if the initial button clicked is in the same area  where the finger was lifted then return what button was clicked
-                if (pButtons[i]->Clicked(x, y) && pButtons[i]->Clicked(touchX, touchY)) {
-                    pReturnButtons = pButtons[i];
-                    break;
-                }
-            }
-        }
-        bPrevBtnPress = bCurrBtnPress;
-    //While loop is designed with bool bWaitForClick to run once if false, so the loop can be asynchronus if needed
-    } while (bWaitForClick && pReturnButtons == NULL);
+public:
+    /*
+    Description: Constructor that starts with no atlas
+    Input: N/A
+    Output: N/A
+    Author: Andrew Popa
+    */
+    TextureAtlas () {
+        pData = NULL;
+        pHeader = NULL;
+        size = 0;
+        bMapped = false;
+    }
 
-    return pReturnButtons;
-}
+    /*
+    Description: Deconstructor that frees the atlas
+    Input: N/A
+    Output: N/A
+    Author: Andrew Popa
+    */
+    ~TextureAtlas () {
+        Unload();
+    }
 
-/*
-Description: Main is just the start menu function that branches out to all other screens
-Input: N/A
-Output: N/A
-Author: Andrew Popa, Woojin Jeon
-*/
-int main() {
-    //Display background and area and create 5 buttons of object Button
-    FEHImage GalaxyBackground("GalaxyBackground.png");
-    //Spacing for easier viewing*
-    Button start_btn(       10,  60,  150, 70, WHITE, GOLDENROD, "Start");
-    Button credits_btn(     165, 60,  150, 70, WHITE, BLUE,      "Credits");
-    Button stats_btn(       10,  160, 150, 70, WHITE, GREEN,     "Stats");
-    Button instructions_btn(165, 160, 150, 70, WHITE, PURPLE,    "Instructions");
-    Button quit_btn(        265, 10,  50,  30, RED,   RED,       "Quit");
-    //load all buttons into button array
-    Button *buttons[] = {&start_btn, &credits_btn, &stats_btn, &instructions_btn, &quit_btn, NULL};
-
-    while(true) {
-        GalaxyBackground.Draw(0, 0);
-
-        //Draw Menu Screen
-        LCD.SetFontColor(WHITE);
-        LCD.WriteAt("Meteorite Dash", 65, 30);
-        DrawButtons(buttons);
-
-        //Wait for a button to be clicked
-        Button *pButtonClicked = CheckButtonsClick(buttons, true);;
-
-        //If else statment to determine which secondary menu to open based on return value of pButtonClicked 
-        if (pButtonClicked == &start_btn) {
-            if (StartGameConfigure()) {
-                ShowStats();
+    /*
+    Description: Loads an atlas file and checks that its header, entries and pixels fit in it
+    Input: File name
+    Output: True if the atlas can be used
+    Author: Andrew Popa
+    */
+    bool Load(const char *pFileName) {
+#ifdef FEH_HEADLESS
+        int file = open(pFileName, O_RDONLY);
+        if (file < 0)
+            return false;
+        struct stat info;
+        if (fstat(file, &info) == 0 && info.st_size > 0) {
+            size = info.st_size;
+            void *pMap = mmap(NULL, size, PROT_READ, MAP_PRIVATE, file, 0);
+            if (pMap != MAP_FAILED) {
+                pData = (unsigned char *)pMap;
+                bMapped = true;
             }
         }
-        else if (pButtonClicked == &credits_btn) {
-            ShowCredits();
-        }
-        else if (pButtonClicked == &stats_btn) {
-            ShowStats();
+        close(file);
+#else
+        FILE *pFile = fopen(pFileName, "rb");
+        if (!pFile)
+            return false;
+        fseek(pFile, 0, SEEK_END);
+        long fileSize = ftell(pFile);
+        fseek(pFile, 0, SEEK_SET);
+        if (fileSize > 0) {
+            size = fileSize;
+            pData = new unsigned char[size];
+            if (fread(pData, 1, size, pFile) != size)
+                Unload();
         }
-        else if (pButtonClicked == &instructions_btn) {
-            ShowInstructions();
+        fclose(pFile);
+#endif
+        if (!pData)
+            return false;
+        const AtlasHeader *pFileHeader = (const AtlasHeader *)pData;
+        bool bValid = size >= sizeof(AtlasHeader) && memcmp(pFileHeader->magic, "MDAT", 4) == 0 &&
+            pFileHeader->version == ATLAS_VERSION && pFileHeader->pixelOffset % 16 == 0 &&
+            pFileHeader->pixelOffset >= sizeof(AtlasHeader) + pFileHeader->count * sizeof(AtlasEntry) &&
+            size >= pFileHeader->pixelOffset + 2ul * pFileHeader->width * pFileHeader->height;
+        if (!bValid) {
+            Unload();
+            return false;
         }
-        else if (pButtonClicked == &quit_btn) {
-            break;
+        pHeader = pFileHeader;
+        pEntries = (const AtlasEntry *)(pData + sizeof(AtlasHeader));
+        pPixels = (const unsigned short *)(pData + pHeader->pixelOffset);
+        return true;
+    }
+
+    /*
+    Description: Checks if an atlas is loaded
+    Input: N/A
+    Output: True if loaded
+    Author: Andrew Popa
+    */
+    bool IsLoaded() {
+        return pHeader != NULL;
+    }
+
+    /*
+    Description: Looks up the entry of an image in the atlas
+    Input: File name of the image
+    Output: Entry that fits in the atlas, NULL if it is not in the atlas
+    Author: Andrew Popa
+    */
+    const AtlasEntry *Entry(const char *name) {
+        if (!pHeader)
+            return NULL;
+        for (unsigned int i = 0; i < pHeader->count; i++) {
+            const AtlasEntry &entry = pEntries[i];
+            if (strncmp(entry.name, name, ATLAS_NAME_LENGTH) == 0 && entry.x + entry.width <= pHeader->width &&
+                    entry.y + entry.height <= pHeader->height)
+                return &entry;
         }
+        return NULL;
     }
-    return 1;
-} 
 
-/*
-Description: Start game function that displays what maps to select and difficulty after map selected. This is 
-the game setup function and the game follows afterwards. Game must be built after this function
-Input: N/A
-Output: True if game has started and false if not
-Author: Andrew Popa
-*/
-bool StartGameConfigure()
-{
-    LCD.Clear(BLACK);
-    FEHImage GalaxyBackground("GalaxyBackground.png");
-    GalaxyBackground.Draw(0, 0);
-    while (true) {
-        //Call Map type function and if map type is default (back button pressed), then break and return to main
-        int mapType = MapSelect();
-        if (mapType == 0) break;
-        //Select difficulty after maptype
-        int meteoriteCount = SelectDifficulty();
-        //If difficulty is either choice, then continue (Black screen shown so far, FIX ME with Game)
-        if (meteoriteCount != 0) {
-            Game(mapType, meteoriteCount);
-            return true;
-        } 
+    /*
+    Description: Looks up an image in the atlas
+    Input: File name of the image
+    Output: New asset drawing from the atlas, NULL if it is not in the atlas
+    Author: Andrew Popa
+    */
+    Asset *Find(const char *name) {
+        const AtlasEntry *pEntry = Entry(name);
+        if (!pEntry)
+            return NULL;
+        return new Asset(pPixels + pEntry->y * pHeader->width + pEntry->x, pEntry->width, pEntry->height, pHeader->width,
+            pEntry->bMasked != 0);
     }
-    return false;
-}
 
-#define SLEEP_MS 10                 //Game Sleeps for 10 ms 
-#define METEORITE_DEATH_MIN 0.2     //20% of life cicles
-#define METEORITE_DEATH_MAX 0.8     //80% of life cicles
-#define SPEED_START 0.5             //the initial speed
-#define SPEED_INCREASE_SECONDS 1    //10 Seconds
-#define SPEED_INCREASE_AMOUNT 0.0075 //Percentage speed the game increases by
-#define METEORITE_RADIUS_MIN 4      //Meteorite min radius
-#define METEORITE_RADIUS_MAX 14     //Meteorite max radius
-#define RANDOM_MAX 32767            //Maximum random value using RANDOM
-#define SCREEN_WIDTH 320
-#define SCREEN_HEIGHT 240
-#define METEORITES_EASY 25          //Number of meteorites on easy mode
-#define METEORITES_HARD 50          //Number of meteorites on hard mode
-#define METEORITE_SPEED_MIN 0.75     //Percentage of gameSpeed
-#define METEORITE_SPEED_MAX 1.25     //Percentage of gameSpeed
-#define PLAYER_RADIUS 6         
-#define PLAYER_Y_HEIGHT 6           //How many pixels from bottom of screen player is raised by
+    /*
+    Description: Size of the atlas file
+    Input: N/A
+    Output: Bytes, 0 if not loaded
+    Author: Andrew Popa
+    */
+    unsigned long Size() {
+        return pHeader ? size : 0;
+    }
+};
 
 /*
-Description: Meteorite function that controls the function of the meteorite such as the generation, or the
-movment and redrawing 
-Private: startDelay which is used for the first time the meteorites are initialized
-Public: radius, x coordinate, y coordinate, speed, respawn delay, Constructor, meteorite reset function, check if alive function, check if just destroyed function
+Description: Asset cache that loads each image the first time it is requested and hands out the same image
+afterwards, so opening a menu again does not decode the same files again. The texture atlas is loaded on the first
+request and images in it are never decoded. Images stay loaded until the game exits
+Private: names, images, number of images, atlas, whether the atlas was tried, LoadAtlas function, Add function
+Public: stats, Constructor, Deconstructor, Get function, IsReady function, Adopt function
 Author: Andrew Popa
 */
-class Meteorite {
-
-    int startDelay;
-
-    public:
-    //if respawnDelay > 0, then wait that many sleep
-    int r, x, respawnDelay = 0;
-    float y, speed;
+class AssetCache {
+    char names[MAX_ASSETS][ASSET_NAME_LENGTH];
+    Asset *pAssets[MAX_ASSETS];
+    int count;
+    TextureAtlas atlas;
+    bool bAtlasTried;
 
     /*
-    Description: Constructor that creates each meteorite with a random speed, size and position
+    Description: Loads the atlas the first time it is needed
     Input: N/A
     Output: N/A
     Author: Andrew Popa
     */
-    Meteorite () {
-        resetMeteorite();
-        //Ensures that the meteorites will spawn uniformly distributed on the screen
-        int AvgMeteoriteCycle = (SCREEN_HEIGHT - (METEORITE_RADIUS_MIN + METEORITE_RADIUS_MAX)) / speed + (DeathMin() + DeathMax()) / 2;
-        //Creates the start delay for each meteorite that makes them uniformly distributed
-        startDelay = Random.RandInt() * AvgMeteoriteCycle / RANDOM_MAX;
+    void LoadAtlas() {
+        if (bAtlasTried)
+            return;
+        bAtlasTried = true;
+        if (atlas.Load(ATLAS_FILE))
+            stats.bytes += atlas.Size();
     }
 
     /*
-    Description: Resets the meteorite once it has passed the death event
-    Input: N/A
-    Output: N/A, resets the meteorite position
+    Description: Keeps an image under its name
+    Input: File name, image
+    Output: The image
     Author: Andrew Popa
     */
-    void resetMeteorite() {
-        //Generates a random speed for each meteorite
-        speed = gameSpeed * (METEORITE_SPEED_MIN + METEORITE_SPEED_MAX * Random.RandInt() / RANDOM_MAX);
-        r = METEORITE_RADIUS_MIN + (Random.RandInt() * (METEORITE_RADIUS_MAX - METEORITE_RADIUS_MIN)) / RANDOM_MAX;
-        y = r + 2;
-        x = r + (Random.RandInt() * (SCREEN_WIDTH - 2 - r - r))/RAND_MAX;
+    Asset *Add(const char *name, Asset *pAsset) {
+        //If the cache is full the image is still returned, but it is kept for the rest of the game without a name
+        if (count < MAX_ASSETS && strlen(name) < ASSET_NAME_LENGTH) {
+            strcpy(names[count], name);
+            pAssets[count++] = pAsset;
+        }
+        return pAsset;
     }
+public:
+    AssetStats stats;
 
     /*
-    Description: Checks if the respawn delay is 0 or not
+    Description: Constructor that starts with an empty cache
     Input: N/A
-    Output: Bool true if delay is 0, False otherwise
+    Output: N/A
     Author: Andrew Popa
     */
-    bool IsAlive() {
-        return respawnDelay == 0;
+    AssetCache () {
+        count = 0;
+        stats.loads = 0;
+        stats.atlasImages = 0;
+        stats.hits = 0;
+        stats.loadSeconds = 0;
+        stats.bytes = 0;
+        bAtlasTried = false;
     }
 
     /*
-    Description: Checks if the meteorite was just destroyed and decrements values of delays if 
-    its not destroyed, and resets meteorites if there is no respawn delay
+    Description: Deconstructor that frees all loaded images
     Input: N/A
-    Output: Return true if meteorite was just destroyed, else false
+    Output: N/A
     Author: Andrew Popa
-    */    
-    bool runMeteorite () {
-        bool bJustDestroyed = false;
-        //If initial delay still exists, then decrement
-        if (startDelay > 0)
-            startDelay--;         
-        //If meteorite dead, decrement respawnDelay
-        else if ( !IsAlive() ) {
-            respawnDelay--;
-            //Respawn Event if meteorite respawnDelay is 0
-            if (respawnDelay == 0)
-                resetMeteorite();
-        }
-        //If meteorite alive then repaint it
-        else if (y < SCREEN_HEIGHT - r) {
-            LCD.SetFontColor(BLACK);
-            LCD.FillCircle(x + 2, y - 2, r);
-            LCD.SetFontColor(DARKSLATEGRAY);
-            LCD.FillCircle(x + 1, y - 1, r);
-            LCD.SetFontColor(LIGHTSLATEGRAY);
-            LCD.FillCircle(x, y, r);
-            y += speed;
-        }
-        else {
-        //If just destroyed, then generate a respawn delay
-            respawnDelay = (DeathMin() + (Random.RandInt() * (DeathMax() - DeathMin())) / RANDOM_MAX) / speed;
-            bJustDestroyed = true;
-        }
-        return bJustDestroyed;
+    */
+    ~AssetCache () {
+        for (int i = 0; i < count; i++)
+            delete pAssets[i];
     }
-    
+
     /*
-    Description: Get the number of cycles the meteorite is on the screen
-    Input: N/A
-    Output: Number of cycles the meteorite is on the screen
+    Description: Returns the image of the given file, taking it from the atlas or loading it if this is the first request
+    Input: File name of the image
+    Output: Pointer to the image, owned by the cache
     Author: Andrew Popa
     */
-    float AliveCycles() {
-        return (SCREEN_HEIGHT - 2 * r) / speed;
+    Asset *Get(const char *name) {
+        for (int i = 0; i < count; i++)
+            if (strcmp(names[i], name) == 0) {
+                stats.hits++;
+                return pAssets[i];
+            }
+        double loadStart = MeasureTime();
+        Asset *pAsset = NULL;
+        LoadAtlas();
+        pAsset = atlas.Find(name);
+        if (pAsset)
+            stats.atlasImages++;
+        if (!pAsset) {
+            FEHImage *pImage = new FEHImage(name);
+            pAsset = new Asset(pImage);
+            stats.loads++;
+#ifdef FEHLCD_HAS_BLIT
+            stats.bytes += pImage->Width() * pImage->Height() * sizeof(*pImage->Pixels());
+#endif
+        }
+        stats.loadSeconds += MeasureTime() - loadStart;
+        return Add(name, pAsset);
     }
-    
+
     /*
-    Description: calculates the minimum cycles a meteorite can have before death
-    Input: N/A
-    Output: Minimum number of cycles the meteorite can be on the screen
+    Description: Checks if Get can return an image without decoding a file, because it is loaded or in the atlas
+    Input: File name of the image
+    Output: True if the image is ready
     Author: Andrew Popa
     */
-    float DeathMin() {
-        return AliveCycles() * METEORITE_DEATH_MIN;
+    bool IsReady(const char *name) {
+        for (int i = 0; i < count; i++)
+            if (strcmp(names[i], name) == 0)
+                return true;
+        LoadAtlas();
+        return atlas.Entry(name) != NULL;
     }
-    
+
     /*
-    Description: calculates the maximum cycles a meteorite can have before death
-    Input: N/A
-    Output: Maximum number of cycles the meteorite can be on the screen
+    Description: Takes an image that was decoded somewhere else, such as on the background loader's thread. If the
+    image was loaded in the meantime the copy is thrown away
+    Input: File name of the image, decoded image which the cache takes ownership of, time spent decoding it
+    Output: Pointer to the image, owned by the cache
     Author: Andrew Popa
     */
-    float DeathMax() {
-        return AliveCycles() * METEORITE_DEATH_MAX;
+    Asset *Adopt(const char *name, FEHImage *pImage, double seconds) {
+        for (int i = 0; i < count; i++)
+            if (strcmp(names[i], name) == 0) {
+                delete pImage;
+                return pAssets[i];
+            }
+        stats.loads++;
+        stats.loadSeconds += seconds;
+#ifdef FEHLCD_HAS_BLIT
+        stats.bytes += pImage->Width() * pImage->Height() * sizeof(*pImage->Pixels());
+#endif
+        return Add(name, new Asset(pImage));
     }
 };
- 
+
+AssetCache Assets;
+
 /*
-Description: Player class that dictates movement and collisions of the Player. It redraws the player when 
-needed and checks where the player has moved. 
-Private: touchDirection function that checks direction pressed, redrawPlayer function
-Public: current x location, PlayerY location function DrawPlayer function
+Description: Loads a map background before the game needs it. The headless build decodes a PNG that is not loaded
+yet on a worker thread, so the menu keeps running while it decodes. The Proteus has no threads, so there it is
+loaded straight away when started, which still moves the wait from the tap to while the menu is idle. Take hands
+the image to the game, waiting for the worker only if it is not done
+Private: name of the image, decoded image, decode time, worker thread, Finish function
+Public: Constructor, Deconstructor, Start function, Take function, IsPrefetched function
 Author: Andrew Popa
 */
-class Player {
+class BackgroundLoader {
+    char name[ASSET_NAME_LENGTH];
+    FEHImage *pImage;
+    double decodeSeconds;
+#ifdef FEH_HEADLESS
+    std::thread worker;
+#endif
+
     /*
-    Description: From Game function, if the touch is not -1 (as given from Game if the screen is not touched), 
-    then find which direction pressed (left or right)
-    Input: x value of where touched
-    Output: 1, if right, -1 if left, 0 if none
+    Description: Waits for the worker and gives the image it decoded to the asset cache
+    Input: N/A
+    Output: N/A
     Author: Andrew Popa
     */
-    int touchDirection(int xTouch) {
-        if (xTouch >= 0)
-            //return 1 if right and -1 if left side touched
-            return xTouch > SCREEN_WIDTH / 2 ? 1 : -1;
-        //0 as default if no touch
-        return 0;
+    void Finish() {
+#ifdef FEH_HEADLESS
+        if (worker.joinable())
+            worker.join();
+#endif
+        if (pImage)
+            Assets.Adopt(name, pImage, decodeSeconds);
+        pImage = NULL;
     }
-    
+public:
     /*
-    Description: Checks which side has been touched and then increments or decrements player on x axis
-    Input: x value of where touched
-    Output: N/A, changes next x position of player
+    Description: Constructor that starts with nothing loading
+    Input: N/A
+    Output: N/A
     Author: Andrew Popa
     */
-    void redrawplayer(int xTouch) {
-        int direction = touchDirection(xTouch);
-        //If statment also checks if the player reaches the boundary of the screen
-        if (xCurrent - PLAYER_RADIUS - 1 > 0 && direction == -1)
-            xCurrent-=2;
-        else if (xCurrent + PLAYER_RADIUS < SCREEN_WIDTH -2 && direction == 1)
-            xCurrent+=2;
+    BackgroundLoader () {
+        name[0] = '\0';
+        pImage = NULL;
+        decodeSeconds = 0;
     }
-    public:
-    int xCurrent;
 
     /*
-    Description: Constructor creating the start x value to 160
+    Description: Deconstructor that waits for the worker and frees an image nobody took
     Input: N/A
-    Output: N/A, initializes start x value to midway of the screen
+    Output: N/A
     Author: Andrew Popa
     */
-    Player () {
-        //Spawns player on center of screen
-        xCurrent = 160;
+    ~BackgroundLoader () {
+#ifdef FEH_HEADLESS
+        if (worker.joinable())
+            worker.join();
+#endif
+        delete pImage;
     }
-    
+
     /*
-    Description: Returns the y value of the player
-    Input: N/A
-    Output: int of the y value of the player
+    Description: Starts loading an image, doing nothing if it is the one already started
+    Input: File name of the image
+    Output: N/A
     Author: Andrew Popa
     */
-    int PlayerY () {
-        return SCREEN_HEIGHT - PLAYER_RADIUS - PLAYER_Y_HEIGHT;
+    void Start(const char *_name) {
+        if (strcmp(name, _name) == 0 || strlen(_name) >= ASSET_NAME_LENGTH)
+            return;
+        Finish();
+        strcpy(name, _name);
+#ifdef FEH_HEADLESS
+        //Images in the atlas or already loaded cost nothing, only decoding a PNG is worth a thread
+        if (!Assets.IsReady(name)) {
+            worker = std::thread([this]() {
+                double decodeStart = MeasureTime();
+                pImage = new FEHImage(name);
+                decodeSeconds = MeasureTime() - decodeStart;
+            });
+            return;
+        }
+#endif
+        Assets.Get(name);
     }
-    
+
     /*
-    Description: Draws all parts of the player
-    Input: x value of the player
-    Output: N/A draws the player
+    Description: Checks if an image was started ahead of Take
+    Input: File name of the image
+    Output: True if it was started
+    Author: Andrew Popa
+    */
+    bool IsPrefetched(const char *_name) {
+        return strcmp(name, _name) == 0;
+    }
+
+    /*
+    Description: Returns a loaded image, waiting for the worker if it is still decoding, or loading it now if it was
+    never started
+    Input: File name of the image
+    Output: The image, owned by the asset cache
     Author: Andrew Popa
     */
-    void DrawPlayer(int xTouch) {
-        redrawplayer(xTouch);
-        LCD.SetFontColor(YELLOWGREEN);
-        LCD.FillCircle(xCurrent, PlayerY(), PLAYER_RADIUS);
-        LCD.SetFontColor(BLUEVIOLET);
-        LCD.DrawPixel(xCurrent - 2, PlayerY() - 3);
-        LCD.DrawPixel(xCurrent + 2, PlayerY() - 3);
-        LCD.DrawHorizontalLine(PlayerY() + 2, xCurrent - 3, xCurrent + 4);
-        LCD.DrawCircle(xCurrent, PlayerY(), PLAYER_RADIUS);
+    Asset &Take(const char *_name) {
+        Finish();
+        return *Assets.Get(_name);
     }
 };
 
+BackgroundLoader Backgrounds;
+
+#ifdef FEH_HEADLESS
 /*
-Description: Checks collisions for all meteorites by using the pythagorean theorem between the x and y distance of the radius of 
-the player and meteorite and checks if its less than the current distance between both of them
-Input: Number of meteorites, array of pointers to each Meteorite object, object of class Player
-Output: True if there is a collision, false otherwise
+Description: Prints the asset cache statistics when the headless run ends
+Input: N/A
+Output: N/A, prints to the console
 Author: Andrew Popa
 */
-bool checkCollisions(int meteoriteCount, Meteorite *pMeteorites[], Player player) {
-    for (int i = 0; i < meteoriteCount; i++) {
-        if ((float)sqrt(pow(player.xCurrent - pMeteorites[i]->x, 2) + pow((player.PlayerY() - pMeteorites[i]->y), 2)) <= (PLAYER_RADIUS + pMeteorites[i]->r) && pMeteorites[i]->IsAlive())
-            return true;
-    }
-    return false;
-
+void ReportAssets() {
+    fprintf(stderr, "assets: %d loads and %d atlas images in %.3f ms, %lu cache hits, %lu KB held\n", Assets.stats.loads,
+        Assets.stats.atlasImages, Assets.stats.loadSeconds * 1000, Assets.stats.hits, Assets.stats.bytes / 1024);
 }
+#endif
+
+#define DRAW_LIST_CAPACITY 256      //Draw commands the list starts with room for, it doubles when a frame needs more
+#define DRAW_TEXT_BYTES 512         //Space the text of the recorded commands starts with, it doubles as well
+
+//Draw order of the recorded commands, lower layers are drawn first
+enum DrawLayer { LAYER_IMAGES, LAYER_PLAYER, LAYER_PLAYER_DETAIL, LAYER_SHADOW_FAR, LAYER_SHADOW_NEAR, LAYER_METEORITES, LAYER_EFFECTS, LAYER_LINES, LAYER_TEXT };
+
+//Kinds of draw commands
+enum DrawKind { DRAW_FILL_CIRCLE, DRAW_CIRCLE, DRAW_PIXEL, DRAW_HORIZONTAL_LINE, DRAW_RECTANGLE, DRAW_TEXT, DRAW_SPRITE, DRAW_ASSET };
 
 /*
-Description: Main game function that only executes after difficulty is selected. It calls all meteorite functions and player functions
-Input: map type, number of meteorites
-Output: N/A, just plays the game
+Description: One recorded draw command. Its sort key is the layer in the top byte and the colour in the rest, and
+the recording order breaks ties so commands with the same key keep their order
 Author: Andrew Popa
 */
-void Game (int mapType, int meteoriteCount) 
-{
-    //Create a pointer to the background name and then depending on the maptype passed, assign the value of the pointer
-    char *pBackgroundName = NULL;
-    if (mapType == 1) 
-        pBackgroundName = "Space.png";
-    else if (mapType == 2) 
-        pBackgroundName = "Lava.png";
-    else if (mapType == 3) 
-        pBackgroundName = "Mines.png";
-    else    //mapType == 4, and the default map if pointer is not initialized
-        pBackgroundName = "Desert.png";
-    FEHImage background(pBackgroundName);
-    
-    //Create the default game speed, and the meteorites survived counter, alongside the cycle counter
-    gameSpeed = SPEED_START;
-    meteoriteSurvived = 0;
-    //create an array of pointers to the meteorites
-    Meteorite *pMeteorites[METEORITES_HARD];
-    Player player;
-    for (int i = 0; i < meteoriteCount; i++)
-        pMeteorites[i] = new Meteorite();
-    //Number of miliseconds since last game started
-    unsigned long gameStart = TimeNowMSec();
-    gameDuration = 1;
-
-    while (true) {
-        //Check if there is a touch, if there isn't assign xTouch to -1, so then there isnt a predefined touch when the loop executes again
-        int xTouch ,yTouch;
-        if (!LCD.Touch(&xTouch, &yTouch))
-            xTouch = -1;
+struct DrawCommand {
+    unsigned int key;
+    int order;
+    int kind;
+    int x, y, width, height;            //Circles use width as the radius, lines use width as the end x
+    const void *pData;                  //Sprite pixels or asset
+    unsigned short spriteKey;           //Sprite pixels of this value are not drawn
+    int textOffset;                     //Where the text of a text command is in the text buffer
+};
 
-        //Clear the previous screen and draw the background then player
-        LCD.Clear(BLACK);
-        background.Draw(0,0);
-        player.DrawPlayer(xTouch);
-        
-        /* In case a border for the game is desired
-        LCD.SetFontColor(__________);
-        LCD.DrawLine(0, 0, SCREEN_WIDTH - 1, 0);
-        LCD.DrawLine(SCREEN_WIDTH - 1, 0, SCREEN_WIDTH - 1, SCREEN_HEIGHT - 1);
-        LCD.DrawLine(SCREEN_WIDTH - 1, SCREEN_HEIGHT - 1, 0, SCREEN_HEIGHT - 1);
-        LCD.DrawLine(0, SCREEN_HEIGHT - 1, 0, 0); */
-
-        //For all the meteorites, if the meteorite has just died, then increment the number of meteorites survived
-        for (int i = 0; i < meteoriteCount; i++)
-            if (pMeteorites[i]->runMeteorite())
-                meteoriteSurvived++;
-        
-        gameDuration = TimeNowMSec() - gameStart;
-        //increment the number of cycles occured, and if the number of cycles divided by SPEED_INCREASE_SECONDS(100) is 0, then increase the speed of the meteorites
-        gameSpeed = SPEED_START + SPEED_INCREASE_AMOUNT * 
-            ( ( gameDuration / 1000 ) / SPEED_INCREASE_SECONDS );
-
-        //sleep, causing the end of the cycle
-        Sleep(SLEEP_MS);
-        
-        //check if there are any collisions and if there are then break from the cycle loop, ending the game 
-        if(checkCollisions(meteoriteCount, pMeteorites, player))
-            break;
-    }
-    //Explosion Animation where the circles increase in size and darken in color
-    LCD.SetFontColor(TOMATO);
-    LCD.FillCircle(player.xCurrent, player.PlayerY(), 16);
-    Sleep(0.2);
-    LCD.SetFontColor(RED);
-    LCD.FillCircle(player.xCurrent, player.PlayerY(), 32);
-    Sleep(0.2);
-    LCD.SetFontColor(DARKRED);
-    LCD.FillCircle(player.xCurrent, player.PlayerY(), 64);
-    Sleep(0.2);
-}
+/*
+Description: Counters of the draw list, used to see how many colour changes and pixels a frame costs
+Author: Andrew Popa
+*/
+struct DrawStats {
+    unsigned long submits;              //Number of times the list was drawn
+    unsigned long commands;             //Commands recorded
+    unsigned long colourChanges;        //Calls to LCD.SetFontColor
+    unsigned long long pixels;          //Pixels drawn, estimated for outlines and text
+    unsigned long grows;                //Times the commands or text had to get more room
+};
 
 /*
-Description: Selects which map for the backgroudn. Function is very similar to main in structure
-Input: N/A
-Output: int 1-4 of which maptype
+Description: Orders draw commands by layer, then colour, then recording order
+Input: Two draw commands
+Output: Negative if a is drawn first
 Author: Andrew Popa
 */
-int MapSelect() 
-{
-    //Draw Background and Title
-    FEHImage GalaxyBackground("GalaxyBackground.png");
-    GalaxyBackground.Draw(0, 0);
-    LCD.SetFontColor(GOLDENROD);
-    LCD.WriteAt("Choose Your Map", 65, 30);
-
-    //Create Buttons objects
-    Button space_btn( 10,  60,  150, 70, DARKTURQUOISE, DARKTURQUOISE, "Space",  "SpaceButton.png");
-    Button lava_btn(  165, 60,  150, 70, ORANGERED,     ORANGERED,     "Lava",   "LavaButton.png");
-    Button mines_btn( 10,  160, 150, 70, LIGHTGRAY,     LIGHTGRAY,     "Mines",  "MinesButton.png");
-    Button desert_btn(165, 160, 150, 70, TAN,           TAN,           "Desert", "DesertButton.png");
-    Button back_btn(  265, 10,  50,  30, WHITE,         WHITE,         "Back");
-
-    //Load Buttons into array with button pointers.
-    Button *buttons[] = {&space_btn, &lava_btn, &mines_btn, &desert_btn, &back_btn, NULL};
-    DrawButtons(buttons);
-    int mapType = 0;
-
-    while(true) {
-        Button *pButtonClicked = CheckButtonsClick(buttons, true);;
-
-        //If else statment to determine which map to select based on return value of pButtonClicked 
-        if (pButtonClicked == &space_btn) {
-            mapType = 1;
-            break;
-        }
-        else if (pButtonClicked == &lava_btn) {
-            mapType = 2;
-            break;
-        }
-        else if (pButtonClicked == &mines_btn) {
-            mapType = 3;
-            break;
-        }
-        else if (pButtonClicked == &desert_btn) {
-            mapType = 4;
-            break;
-        }
-        else if (pButtonClicked == &back_btn) {
-            break;
-        }
-    }
-    return mapType;
+int CompareDrawCommands(const void *a, const void *b) {
+    const DrawCommand *pA = (const DrawCommand *)a, *pB = (const DrawCommand *)b;
+    if (pA->key != pB->key)
+        return pA->key < pB->key ? -1 : 1;
+    return pA->order - pB->order;
 }
 
 /*
-Description: Selects which difficulty. Function is very similar to main in structure, just less buttons
-Input: N/A
-Output: int dictating number of meteorites.
+Description: Draw list that objects record their drawing into during a frame instead of drawing straight away. Submit
+sorts the commands by layer and colour and draws them in one pass, so the colour is only changed when it actually
+differs, and filled circles of the same colour and layer are turned into rows of spans with the overlapping spans
+merged, so overlapping pixels are only drawn once. Also the one place that counts commands and pixels drawn. The
+list is never drawn before Submit: when a frame records more than it has room for, the room doubles, so the
+layers of a frame are always drawn in order. The room only grows to the largest frame drawn
+Private: commands, their capacity, number of commands, text buffer, its capacity, bytes of it used, spans of a row,
+Grow function, Add function, Draw function, DrawCircles function
+Public: stats, Constructor, Deconstructor, FillCircle function, Circle function, Pixel function, HorizontalLine function, Rectangle
+function, Text function, Sprite function, Image function, Submit function
 Author: Andrew Popa
 */
-int SelectDifficulty() 
+class DrawList {
+    DrawCommand *commands;
+    int capacity, count;
+    char *text;
+    int textCapacity, textUsed;
+    int *spanStart, *spanEnd;
+
+    /*
+    Description: Doubles the room for commands (and the spans, one per command at most) or for text, keeping what
+    was recorded
+    Input: True to grow the text buffer, false for the commands
+    Output: N/A
+    Author: Andrew Popa
+    */
+    void Grow(bool bText) {
+        if (bText) {
+            char *pNewText = new char[2 * textCapacity];
+            memcpy(pNewText, text, textUsed);
+            delete[] text;
+            text = pNewText;
+            textCapacity *= 2;
+        } else {
+            DrawCommand *pNewCommands = new DrawCommand[2 * capacity];
+            memcpy(pNewCommands, commands, count * sizeof(DrawCommand));
+            delete[] commands;
+            delete[] spanStart;
+            delete[] spanEnd;
+            commands = pNewCommands;
+            capacity *= 2;
+            spanStart = new int[capacity];
+            spanEnd = new int[capacity];
+        }
+        stats.grows++;
+    }
+
+    /*
+    Description: Records a command, making room for it first if the list is full
+    Input: Layer, colour, kind, position and size
+    Output: The recorded command, to fill in the rest
+    Author: Andrew Popa
+    */
+    DrawCommand &Add(int layer, unsigned int colour, int kind, int x, int y, int width, int height) {
+        if (count == capacity)
+            Grow(false);
+        DrawCommand &command = commands[count];
+        command.key = (unsigned int)layer << 24 | (colour & 0xFFFFFF);
+        command.order = count++;
+        command.kind = kind;
+        command.x = x;
+        command.y = y;
+        command.width = width;
+        command.height = height;
+        command.pData = NULL;
+        stats.commands++;
+        return command;
+    }
+
+    /*
+    Description: Draws one command that is not a filled circle
+    Input: Command
+    Output: N/A
+    Author: Andrew Popa
+    */
+    void Draw(const DrawCommand &command) {
+        switch (command.kind) {
+        case DRAW_CIRCLE:
+            LCD.DrawCircle(command.x, command.y, command.width);
+            stats.pixels += (unsigned long long)(6.28 * command.width);
+            break;
+        case DRAW_PIXEL:
+            LCD.DrawPixel(command.x, command.y);
+            stats.pixels++;
+            break;
+        case DRAW_HORIZONTAL_LINE:
+            LCD.DrawHorizontalLine(command.y, command.x, command.width);
+            stats.pixels += command.width - command.x + 1;
+            break;
+        case DRAW_RECTANGLE:
+            LCD.DrawRectangle(command.x, command.y, command.width, command.height);
+            stats.pixels += 2 * (command.width + command.height);
+            break;
+        case DRAW_TEXT:
+            LCD.WriteAt(text + command.textOffset, command.x, command.y);
+            stats.pixels += strlen(text + command.textOffset) * CHAR_WIDTH * CHAR_HEIGHT;
+            break;
+#ifdef FEHLCD_HAS_BLIT
+        case DRAW_SPRITE:
+            LCD.BlitMasked(command.x, command.y, command.width, command.height, (const unsigned short *)command.pData,
+                command.width, command.spriteKey);
+            stats.pixels += command.width * command.height;
+            break;
+#endif
+        case DRAW_ASSET:
+            ((Asset *)command.pData)->Draw(command.x, command.y);
+            stats.pixels += command.width * command.height;
+            break;
+        }
+    }
+
+    /*
+    Description: Draws filled circles of the same layer and colour row by row. The spans of the circles in each row
+    are sorted and the ones that overlap or touch are merged, so each pixel is drawn once. The spans are the same
+    ones FillCircle draws
+    Input: Index of the first and one past the last circle in the sorted commands
+    Output: N/A
+    Author: Andrew Popa
+    */
+    void DrawCircles(int first, int last) {
+        int top = commands[first].y - commands[first].width, bottom = commands[first].y + commands[first].width;
+        for (int c = first + 1; c < last; c++) {
+            if (commands[c].y - commands[c].width < top) top = commands[c].y - commands[c].width;
+            if (commands[c].y + commands[c].width > bottom) bottom = commands[c].y + commands[c].width;
+        }
+        for (int row = top; row <= bottom; row++) {
+            int spans = 0;
+            for (int c = first; c < last; c++) {
+                int r = commands[c].width, dy = row - commands[c].y;
+                if (dy < -r || dy > r)
+                    continue;
+                int dx = (int)sqrt((double)(r * r - dy * dy));
+                //Insert in order of start x
+                int k = spans++;
+                for (; k > 0 && spanStart[k - 1] > commands[c].x - dx; k--) {
+                    spanStart[k] = spanStart[k - 1];
+                    spanEnd[k] = spanEnd[k - 1];
+                }
+                spanStart[k] = commands[c].x - dx;
+                spanEnd[k] = commands[c].x + dx;
+            }
+            for (int s = 0; s < spans; ) {
+                int start = spanStart[s], end = spanEnd[s];
+                for (s++; s < spans && spanStart[s] <= end + 1; s++)
+                    if (spanEnd[s] > end)
+                        end = spanEnd[s];
+                LCD.DrawHorizontalLine(row, start, end);
+                stats.pixels += end - start + 1;
+            }
+        }
+    }
+
+public:
+    DrawStats stats;
+
+    /*
+    Description: Constructor that starts with an empty list
+    Input: N/A
+    Output: N/A
+    Author: Andrew Popa
+    */
+    DrawList () {
+        capacity = DRAW_LIST_CAPACITY;
+        commands = new DrawCommand[capacity];
+        spanStart = new int[capacity];
+        spanEnd = new int[capacity];
+        textCapacity = DRAW_TEXT_BYTES;
+        text = new char[textCapacity];
+        count = 0;
+        textUsed = 0;
+        stats.submits = stats.commands = stats.colourChanges = stats.grows = 0;
+        stats.pixels = 0;
+    }
+
+    /*
+    Description: Deconstructor that frees the commands, spans and text
+    Input: N/A
+    Output: N/A
+    Author: Andrew Popa
+    */
+    ~DrawList () {
+        delete[] commands;
+        delete[] spanStart;
+        delete[] spanEnd;
+        delete[] text;
+    }
+
+    void FillCircle(int layer, unsigned int colour, int x, int y, int r) { Add(layer, colour, DRAW_FILL_CIRCLE, x, y, r, 0); }
+    void Circle(int layer, unsigned int colour, int x, int y, int r) { Add(layer, colour, DRAW_CIRCLE, x, y, r, 0); }
+    void Pixel(int layer, unsigned int colour, int x, int y) { Add(layer, colour, DRAW_PIXEL, x, y, 0, 0); }
+    void HorizontalLine(int layer, unsigned int colour, int y, int x1, int x2) { Add(layer, colour, DRAW_HORIZONTAL_LINE, x1, y, x2, 0); }
+    void Rectangle(int layer, unsigned int colour, int x, int y, int width, int height) { Add(layer, colour, DRAW_RECTANGLE, x, y, width, height); }
+
+    /*
+    Description: Records text, which is copied so it does not have to live until Submit
+    Input: Layer, colour, text, top left x and y coordinate
+    Output: N/A
+    Author: Andrew Popa
+    */
+    void Text(int layer, unsigned int colour, const char *pText, int x, int y) {
+        int length = strlen(pText) + 1;
+        while (textUsed + length > textCapacity)
+            Grow(true);
+        DrawCommand &command = Add(layer, colour, DRAW_TEXT, x, y, 0, 0);
+        command.textOffset = textUsed;
+        memcpy(text + textUsed, pText, length);
+        textUsed += length;
+    }
+
+    /*
+    Description: Records a masked copy of a sprite, which has no colour. The pixels must live until Submit
+    Input: Layer, top left x and y coordinate, size, pixels, value of the pixels that are not drawn
+    Output: N/A
+    Author: Andrew Popa
+    */
+    void Sprite(int layer, int x, int y, int width, int height, const unsigned short *pPixels, unsigned short key) {
+        DrawCommand &command = Add(layer, 0, DRAW_SPRITE, x, y, width, height);
+        command.pData = pPixels;
+        command.spriteKey = key;
+    }
+
+    /*
+    Description: Records an image from the asset cache, which has no colour
+    Input: Layer, image, top left x and y coordinate, size of the image for the pixel count
+    Output: N/A
+    Author: Andrew Popa
+    */
+    void Image(int layer, Asset *pAsset, int x, int y, int width, int height) {
+        DrawCommand &command = Add(layer, 0, DRAW_ASSET, x, y, width, height);
+        command.pData = pAsset;
+    }
+
+    /*
+    Description: Draws every recorded command sorted by layer and colour, setting the colour only when it changes,
+    and empties the list
+    Input: N/A
+    Output: N/A, draws to the LCD
+    Author: Andrew Popa
+    */
+    void Submit() {
+        if (count == 0)
+            return;
+        stats.submits++;
+        qsort(commands, count, sizeof(DrawCommand), CompareDrawCommands);
+        bool bColourSet = false;
+        unsigned int colour = 0;
+        for (int c = 0; c < count; ) {
+            const DrawCommand &command = commands[c];
+            bool bColoured = command.kind != DRAW_SPRITE && command.kind != DRAW_ASSET;
+            if (bColoured && (!bColourSet || (command.key & 0xFFFFFF) != colour)) {
+                colour = command.key & 0xFFFFFF;
+                bColourSet = true;
+                LCD.SetFontColor(colour);
+                stats.colourChanges++;
+            }
+            if (command.kind == DRAW_FILL_CIRCLE) {
+                int last = c + 1;
+                while (last < count && commands[last].kind == DRAW_FILL_CIRCLE && commands[last].key == command.key)
+                    last++;
+                DrawCircles(c, last);
+                c = last;
+            } else {
+                Draw(command);
+                //Images may change the colour while drawing
+                if (command.kind == DRAW_ASSET)
+                    bColourSet = false;
+                c++;
+            }
+        }
+        count = 0;
+        textUsed = 0;
+    }
+};
+
+//Draw list of the current frame or menu
+DrawList Canvas;
+
+#define INPUT_QUEUE_SIZE 16         //Number of touch events that can wait to be read
+#define INPUT_POLL_MS 10            //How long WaitForEvent sleeps between touch screen polls
+
+/*
+Description: Touch event, a finger pressed or lifted. A release also carries where its press started
+Author: Andrew Popa
+*/
+struct TouchEvent {
+    bool bPress;            //true if the finger was pressed, false if lifted
+    int x, y;               //Where it happened
+    int pressX, pressY;     //Where the finger was pressed, for a release
+};
+
+/*
+Description: Input subsystem that turns polling the touch screen into a queue of press and release events. The
+scene loop reads the events of each frame without waiting with NextEvent, or waits for one with WaitForEvent when
+the scene has nothing to animate, and the game just polls and looks at the current touch
+Private: event queue, queue start and length, if the finger is down, touch location, press location, if the press
+started after the last flush
+Public: Constructor, Poll function, NextEvent function, WaitForEvent function, Flush function, IsDown function
+Author: Andrew Popa
+*/
+class TouchInput {
+    TouchEvent queue[INPUT_QUEUE_SIZE];
+    int queueStart, queueLength;
+    bool bDown, bPressValid;
+    int touchX, touchY, pressX, pressY;
+
+    /*
+    Description: Adds an event to the end of the queue, dropping it if the queue is full
+    Input: The event
+    Output: N/A
+    Author: Andrew Popa
+    */
+    void Push(TouchEvent event) {
+        if (queueLength < INPUT_QUEUE_SIZE)
+            queue[(queueStart + queueLength++) % INPUT_QUEUE_SIZE] = event;
+    }
+public:
+    /*
+    Description: Constructor that starts with no finger down and an empty queue
+    Input: N/A
+    Output: N/A
+    Author: Andrew Popa
+    */
+    TouchInput () {
+        queueStart = queueLength = 0;
+        bDown = bPressValid = false;
+        touchX = touchY = pressX = pressY = -1;
+    }
+
+    /*
+    Description: Reads the touch screen once and queues an event if the finger was just pressed or lifted
+    Input: N/A
+    Output: N/A
+    Author: Andrew Popa
+    */
+    void Poll() {
+        int x, y;
+        bool bTouched = LCD.Touch(&x, &y);
+        if (bTouched) {
+            touchX = x;
+            touchY = y;
+        }
+        //If user just pressed the finger, record the press location
+        if (!bDown && bTouched) {
+            pressX = x;
+            pressY = y;
+            bPressValid = true;
+            TouchEvent event = {true, x, y, x, y};
+            Push(event);
+        }
+        //If user just lifted the finger, the release is where the finger last was
+        else if (bDown && !bTouched && bPressValid) {
+            TouchEvent event = {false, touchX, touchY, pressX, pressY};
+            Push(event);
+        }
+        bDown = bTouched;
+    }
+
+    /*
+    Description: Polls once and takes the next event out of the queue, without waiting
+    Input: Event to fill in
+    Output: True if there was an event
+    Author: Andrew Popa
+    */
+    bool NextEvent(TouchEvent &event) {
+        if (queueLength == 0)
+            Poll();
+        if (queueLength == 0)
+            return false;
+        event = queue[queueStart];
+        queueStart = (queueStart + 1) % INPUT_QUEUE_SIZE;
+        queueLength--;
+        return true;
+    }
+
+    /*
+    Description: Waits until there is an event, sleeping between polls so waiting does not use the processor
+    Input: Event to fill in
+    Output: True once there is an event
+    Author: Andrew Popa
+    */
+    bool WaitForEvent(TouchEvent &event) {
+        while (!NextEvent(event))
+            Sleep(INPUT_POLL_MS);
+        return true;
+    }
+
+    /*
+    Description: Throws away the queued events and the press in progress, so a screen does not get a release or
+    press left over from the previous screen
+    Input: N/A
+    Output: N/A
+    Author: Andrew Popa
+    */
+    void Flush() {
+        queueLength = 0;
+        bPressValid = false;
+    }
+
+    /*
+    Description: Polls once, throws away the queued events and returns where the finger is now
+    Input: x and y to fill in with the touch location
+    Output: True if the finger is down
+    Author: Andrew Popa
+    */
+    bool IsDown(int *x, int *y) {
+        Poll();
+        queueLength = 0;
+        *x = touchX;
+        *y = touchY;
+        return bDown;
+    }
+};
+
+TouchInput Input;
+
+#define SPRITE_KEY 0xF81F           //Sprite and text surface pixels of this value are not drawn (magenta)
+#define TEXT_CACHE_SIZE 64          //Different strings and colours the text cache keeps
+#define GLYPH_COLOURS 4             //Colours the glyph atlas keeps
+#define GLYPH_CELL (CHAR_WIDTH * CHAR_HEIGHT)
+
+//Characters of the glyph atlas, enough for the numbers, times and seeds of the readouts
+const char glyphChars[] = "0123456789.-ABCDEF";
+#define GLYPH_COUNT ((int)sizeof(glyphChars) - 1)
+
+/*
+Description: Counters of the text cache and glyph atlas
+Author: Andrew Popa
+*/
+struct TextStats {
+    unsigned long renders;              //Strings and glyph colours drawn into a surface
+    unsigned long hits;                 //Text drawn from a surface that was already there
+    unsigned long misses;               //Text drawn glyph by glyph because it could not be cached
+    unsigned long bytes;                //Memory held by the surfaces
+};
+
+/*
+Description: Text drawn once into its own surface, so it is drawn afterwards with one masked copy instead of glyph
+by glyph. Strings are found by their content and colour. When the LCD can not copy pixel blocks, or the cache is
+full, the text is drawn as before
+Private: strings, their colours, hashes, widths and surfaces, number of strings, Hash function, Render function
+Public: stats, Constructor, Deconstructor, Draw function
+Author: Andrew Popa
+*/
+class TextCache {
+#ifdef FEHLCD_HAS_BLIT
+    char *pTexts[TEXT_CACHE_SIZE];
+    unsigned int colours[TEXT_CACHE_SIZE];
+    unsigned int hashes[TEXT_CACHE_SIZE];
+    int widths[TEXT_CACHE_SIZE];
+    unsigned short *pSurfaces[TEXT_CACHE_SIZE];
+    int count;
+
+    /*
+    Description: FNV-1a hash of a string, so most strings are told apart without comparing them
+    Input: Text
+    Output: Hash
+    Author: Andrew Popa
+    */
+    unsigned int Hash(const char *pText) {
+        unsigned int hash = 2166136261u;
+        for (; *pText; pText++)
+            hash = (hash ^ (unsigned char)*pText) * 16777619u;
+        return hash;
+    }
+
+    /*
+    Description: Draws a string into a new surface by sending the LCD's drawing to it
+    Input: Text, colour, hash of the text
+    Output: Index of the surface
+    Author: Andrew Popa
+    */
+    int Render(const char *pText, unsigned int colour, unsigned int hash) {
+        int length = strlen(pText);
+        int width = length * CHAR_WIDTH;
+        pTexts[count] = new char[length + 1];
+        strcpy(pTexts[count], pText);
+        colours[count] = colour;
+        hashes[count] = hash;
+        widths[count] = width;
+        pSurfaces[count] = new unsigned short[width * CHAR_HEIGHT];
+        LCD.SetRenderTarget(pSurfaces[count], width, CHAR_HEIGHT);
+        LCD.Clear(LCD.FromNative(SPRITE_KEY));
+        LCD.SetFontColor(colour);
+        LCD.WriteAt(pText, 0, 0);
+        LCD.SetRenderTarget(NULL, 0, 0);
+        stats.renders++;
+        stats.bytes += width * CHAR_HEIGHT * sizeof(unsigned short) + length + 1;
+        return count++;
+    }
+#endif
+
+public:
+    TextStats stats;
+
+    /*
+    Description: Constructor that starts empty
+    Input: N/A
+    Output: N/A
+    Author: Andrew Popa
+    */
+    TextCache () {
+#ifdef FEHLCD_HAS_BLIT
+        count = 0;
+#endif
+        stats.renders = stats.hits = stats.misses = stats.bytes = 0;
+    }
+
+    ~TextCache () {
+#ifdef FEHLCD_HAS_BLIT
+        for (int i = 0; i < count; i++) {
+            delete[] pTexts[i];
+            delete[] pSurfaces[i];
+        }
+#endif
+    }
+
+    /*
+    Description: Records text into the draw list, from its surface if it has one. The surface is drawn the first
+    time a string and colour are seen. A colour equal to the sprite key could not be told from the gaps between the
+    glyphs, so it is never cached
+    Input: Layer, colour, text, top left x and y coordinate
+    Output: N/A, drawn when the draw list is submitted
+    Author: Andrew Popa
+    */
+    void Draw(int layer, unsigned int colour, const char *pText, int x, int y) {
+#ifdef FEHLCD_HAS_BLIT
+        if (pText[0] != '\0' && LCD.ToNative(colour) != SPRITE_KEY) {
+            unsigned int hash = Hash(pText);
+            int found = -1;
+            for (int i = 0; i < count && found < 0; i++)
+                if (hashes[i] == hash && colours[i] == colour && strcmp(pTexts[i], pText) == 0)
+                    found = i;
+            if (found >= 0)
+                stats.hits++;
+            else if (count < TEXT_CACHE_SIZE)
+                found = Render(pText, colour, hash);
+            if (found >= 0) {
+                Canvas.Sprite(layer, x, y, widths[found], CHAR_HEIGHT, pSurfaces[found], SPRITE_KEY);
+                return;
+            }
+        }
+#endif
+        stats.misses++;
+        Canvas.Text(layer, colour, pText, x, y);
+    }
+};
+
+TextCache Texts;
+
+/*
+Description: Atlas of the glyphs numbers are written with, each drawn once per colour into a character cell. Text
+that changes, like the stats readouts, is drawn with one masked copy per character from it instead of filling the
+text cache with every value it takes
+Private: glyph cells, their colours, number of colours, Find function
+Public: Constructor, Draw function
+Author: Andrew Popa
+*/
+class GlyphAtlas {
+#ifdef FEHLCD_HAS_BLIT
+    unsigned short cells[GLYPH_COLOURS][GLYPH_COUNT][GLYPH_CELL];
+    unsigned int colours[GLYPH_COLOURS];
+    int count;
+
+    /*
+    Description: Finds the glyphs of a colour, drawing them the first time the colour is used
+    Input: Colour
+    Output: Index of the colour, -1 if the atlas has no room for it
+    Author: Andrew Popa
+    */
+    int Find(unsigned int colour) {
+        for (int i = 0; i < count; i++)
+            if (colours[i] == colour)
+                return i;
+        if (count == GLYPH_COLOURS || LCD.ToNative(colour) == SPRITE_KEY)
+            return -1;
+        colours[count] = colour;
+        LCD.SetFontColor(colour);
+        for (int g = 0; g < GLYPH_COUNT; g++) {
+            char glyph[2] = {glyphChars[g], '\0'};
+            LCD.SetRenderTarget(cells[count][g], CHAR_WIDTH, CHAR_HEIGHT);
+            LCD.Clear(LCD.FromNative(SPRITE_KEY));
+            LCD.WriteAt(glyph, 0, 0);
+        }
+        LCD.SetRenderTarget(NULL, 0, 0);
+        Texts.stats.renders++;
+        Texts.stats.bytes += sizeof(cells[0]);
+        return count++;
+    }
+#endif
+
+public:
+    /*
+    Description: Constructor that starts with no colours drawn
+    Input: N/A
+    Output: N/A
+    Author: Andrew Popa
+    */
+    GlyphAtlas () {
+#ifdef FEHLCD_HAS_BLIT
+        count = 0;
+#endif
+    }
+
+    /*
+    Description: Records text made of atlas characters (and spaces) as one copy per character. Any other text is
+    drawn glyph by glyph
+    Input: Layer, colour, text, top left x and y coordinate
+    Output: N/A, drawn when the draw list is submitted
+    Author: Andrew Popa
+    */
+    void Draw(int layer, unsigned int colour, const char *pText, int x, int y) {
+#ifdef FEHLCD_HAS_BLIT
+        int length = strlen(pText);
+        bool bAtlas = length > 0;
+        for (int i = 0; i < length && bAtlas; i++)
+            bAtlas = pText[i] == ' ' || strchr(glyphChars, pText[i]);
+        int c = bAtlas ? Find(colour) : -1;
+        if (c >= 0) {
+            for (int i = 0; i < length; i++)
+                if (pText[i] != ' ')
+                    Canvas.Sprite(layer, x + i * CHAR_WIDTH, y, CHAR_WIDTH, CHAR_HEIGHT,
+                        cells[c][strchr(glyphChars, pText[i]) - glyphChars], SPRITE_KEY);
+            Texts.stats.hits++;
+            return;
+        }
+#endif
+        Texts.stats.misses++;
+        Canvas.Text(layer, colour, pText, x, y);
+    }
+};
+
+GlyphAtlas Glyphs;
+
+#ifdef FEH_HEADLESS
+/*
+Description: Prints the text cache statistics when the headless run ends
+Input: N/A
+Output: N/A, prints to the console
+Author: Andrew Popa
+*/
+void ReportText() {
+    fprintf(stderr, "text: %lu surfaces drawn, %lu copies from them, %lu drawn glyph by glyph, %lu KB held\n",
+        Texts.stats.renders, Texts.stats.hits, Texts.stats.misses, Texts.stats.bytes / 1024);
+}
+#endif
+
+/*
+Description: Screen rectangle used to keep track of what was drawn over the background
+Author: Andrew Popa
+*/
+struct Rect {
+    int x, y, width, height;
+};
+
+#define LABEL_LENGTH 32             //Longest text a label can hold
+
+/*
+Description: Element of a retained widget tree. It remembers the area it covers now and the area it covered when it
+was last painted, and is marked dirty when it changes, so a screen only repaints the widgets that changed
+Protected: area, area when last painted, dirty flag
+Public: Constructor, Deconstructor, Draw function, Move function, MarkDirty function, IsDirty function, Area
+function, PaintedArea function, Painted function
+Author: Andrew Popa
+*/
+class Widget {
+protected:
+    Rect area, paintedArea;
+    bool bDirty;
+public:
+    /*
+    Description: Constructor that starts dirty, since it was never painted
+    Input: Top left x and y coordinate, width and height of what it draws
+    Output: N/A
+    Author: Andrew Popa
+    */
+    Widget (int x, int y, int width, int height) {
+        Rect rect = {x, y, width, height};
+        area = paintedArea = rect;
+        bDirty = true;
+    }
+
+    /*
+    Description: Deconstructor, virtual so a widget can be deleted through its base class
+    Input: N/A
+    Output: N/A
+    Author: Andrew Popa
+    */
+    virtual ~Widget () {}
+
+    /*
+    Description: Records the widget into the draw list
+    Input: N/A
+    Output: N/A, drawn when the draw list is submitted
+    Author: Andrew Popa
+    */
+    virtual void Draw() = 0;
+
+    /*
+    Description: Moves the widget, marking it dirty if it actually moved
+    Input: New top left x and y coordinate
+    Output: N/A
+    Author: Andrew Popa
+    */
+    void Move(int x, int y) {
+        if (x == area.x && y == area.y)
+            return;
+        area.x = x;
+        area.y = y;
+        bDirty = true;
+    }
+
+    /*
+    Description: Marks the widget to be repainted, for changes the widget does not see itself
+    Input: N/A
+    Output: N/A
+    Author: Andrew Popa
+    */
+    void MarkDirty() { bDirty = true; }
+
+    /*
+    Description: Checks if the widget changed since it was last painted
+    Input: N/A
+    Output: True if it needs to be repainted
+    Author: Andrew Popa
+    */
+    bool IsDirty() { return bDirty; }
+
+    /*
+    Description: Gets the area the widget covers now
+    Input: N/A
+    Output: The area
+    Author: Andrew Popa
+    */
+    const Rect &Area() { return area; }
+
+    /*
+    Description: Gets the area the widget covered when it was last painted, which is erased before it is painted again
+    Input: N/A
+    Output: The area
+    Author: Andrew Popa
+    */
+    const Rect &PaintedArea() { return paintedArea; }
+
+    /*
+    Description: Remembers that the widget was painted where it is now
+    Input: N/A
+    Output: N/A
+    Author: Andrew Popa
+    */
+    void Painted() {
+        paintedArea = area;
+        bDirty = false;
+    }
+};
+
+/*
+Description: Line of text in a widget tree. Its size is worked out when the text is set, not every time it is drawn,
+and it is drawn from the text cache
+Protected: text, colour
+Public: Constructor, SetText function, Draw function
+Author: Andrew Popa
+*/
+class Label : public Widget {
+protected:
+    char text[LABEL_LENGTH];
+    unsigned int colour;
+public:
+    /*
+    Description: Constructor that sets the text and its position
+    Input: Top left x and y coordinate, colour, text
+    Output: N/A
+    Author: Andrew Popa
+    */
+    Label (int x, int y, unsigned int _colour, const char *_text) : Widget(x, y, 0, CHAR_HEIGHT) {
+        colour = _colour;
+        text[0] = '\0';
+        SetText(_text);
+    }
+
+    /*
+    Description: Changes the text, marking the label dirty if it is different. Text longer than LABEL_LENGTH is cut
+    Input: Text
+    Output: N/A
+    Author: Andrew Popa
+    */
+    void SetText(const char *_text) {
+        if (strncmp(text, _text, LABEL_LENGTH - 1) == 0)
+            return;
+        strncpy(text, _text, LABEL_LENGTH - 1);
+        text[LABEL_LENGTH - 1] = '\0';
+        //The painted area keeps the old width, so the old text is still erased if the new one is shorter
+        area.width = strlen(text) * CHAR_WIDTH;
+        bDirty = true;
+    }
+
+    /*
+    Description: Records the text into the draw list from the text cache
+    Input: N/A
+    Output: N/A, drawn when the draw list is submitted
+    Author: Andrew Popa
+    */
+    void Draw() {
+        Texts.Draw(LAYER_TEXT, colour, text, area.x, area.y);
+    }
+};
+
+/*
+Description: Label for a number that changes, like the stats. It is drawn from the glyph atlas instead of the text
+cache, so its values do not fill the cache
+Public: Constructor, Draw function
+Author: Andrew Popa
+*/
+class Readout : public Label {
+public:
+    /*
+    Description: Constructor that starts with no text, the value is set with SetText
+    Input: Top left x and y coordinate, colour
+    Output: N/A
+    Author: Andrew Popa
+    */
+    Readout (int x, int y, unsigned int _colour) : Label(x, y, _colour, "") {}
+
+    /*
+    Description: Records the text into the draw list from the glyph atlas
+    Input: N/A
+    Output: N/A, drawn when the draw list is submitted
+    Author: Andrew Popa
+    */
+    void Draw() {
+        Glyphs.Draw(LAYER_TEXT, colour, text, area.x, area.y);
+    }
+};
+
+/*
+Description:Class Button that creates an object button that is used to draw the button and check
+if the button has been clicked. It is a widget, so it can be part of a widget tree, and its location and size come
+from the widget's area. Where its text goes is worked out once in the constructor, as an offset so it follows Move
+Private: color, text color, text, image, text offset
+Public: Constructor, Draw function, Clicked function
+Author: Andrew Popa 
+*/
+class Button : public Widget {
+    int buttonColor, textColor;
+    char *text;
+    Asset *pImage;
+    int textXOffset, textYOffset;
+public: 
+    /*
+    Description: Constructor that initializes the values for the button
+    Input: Top left x and y coordinate, height and width, button color, text to display, and image to display
+    Output: N/A
+    Author: Andrew Popa
+    */
+    Button (int _x, int _y, int _width, int _height, int _buttonColor, int _textColor, char* _text, char* imageName = NULL) :
+        //The border is drawn on both edges, so it covers one pixel more than the size each way
+        Widget(_x, _y, _width + 1, _height + 1) {
+        buttonColor = _buttonColor;
+        textColor = _textColor;
+        text = _text;
+        //Inline if checking if the passed pointer for the image is null or not, and getting the image from the asset cache if not NULL
+        pImage =  imageName ? Assets.Get(imageName) : NULL;
+        /*Takes the length of the box and the length of the text and then subtracts them from each other, and divides
+        this length by 2 to determine the distance between the centered text and the edge of the box, writing the text
+        at the start of this margin*/
+        textXOffset = (_width - (int)(strlen(text)*CHAR_WIDTH)) / 2;
+        textYOffset = 2 + (_height-CHAR_HEIGHT) / 2;
+    }
+    /*
+    Description: Records the button with the given parameters passed when the Button object is called into the draw list
+    Input: N/A
+    Output: N/A, drawn when the draw list is submitted
+    Author: Andrew Popa
+    */
+    void Draw() {
+        //The area includes the border's extra pixel, so the button's own size is one less
+        int width = area.width - 1, height = area.height - 1;
+        //If the pointer to the image is not NULL, then draw the image in the coordinates shown
+        if (pImage) 
+            //x + 1 and y + 1, because the border takes a pixel
+            Canvas.Image(LAYER_IMAGES, pImage, area.x + 1, area.y + 1, width - 1, height - 1);
+        Canvas.Rectangle(LAYER_LINES, buttonColor, area.x, area.y, width, height);
+        Texts.Draw(LAYER_TEXT, textColor, text, area.x + textXOffset, area.y + textYOffset);
+    }
+
+    /*
+    Description: Checks if the inputted values match with were a button was clicked.
+    Input: X and Y coordinates of the click
+    Output: True if clicked inside of the button it was called on
+    Author: Andrew Popa
+    */
+    bool Clicked(int xClick, int yClick) {
+        int width = area.width - 1, height = area.height - 1;
+        return xClick > area.x && xClick < area.x + width && yClick > area.y && yClick < area.y + height;
+    }
+};
+
+/*
+Description: Main just runs the scenes, starting with the start menu that branches out to all other screens. The headless build
+runs the batch simulator instead when started with --batch, plays a replay when started with --replay, and
+simulates games on their own thread when started with --threaded
+Input: Command line arguments
+Output: N/A
+Author: Andrew Popa, Woojin Jeon
+*/
+int main(int argc, char *argv[]) {
+#ifdef FEH_HEADLESS
+    if (argc > 1 && strcmp(argv[1], "--batch") == 0)
+        return RunBatch(argc - 2, argv + 2);
+    if (argc > 1 && strcmp(argv[1], "--replay") == 0)
+        return RunReplay(argc - 2, argv + 2);
+    if (argc > 1 && strcmp(argv[1], "--threaded") == 0)
+        bThreadedGame = true;
+    atexit(ReportAssets);
+    atexit(ReportText);
+    atexit(ReportScenes);
+#endif
+    RunScenes();
+    return 1;
+} 
+
+#define SLEEP_MS 10                 //Length of a game tick, the game sleeps for what is left of it after drawing
+#define MAX_TICKS_PER_FRAME 5       //If drawing falls further behind than this many ticks, the game slows down
+#ifndef METEORITES_STRESS
+#define METEORITES_STRESS 400       //Number of meteorites of the stress preset, can be changed when building
+#endif
+
+/*
+Description: Configuration of the game known at compile time. Code templated on a configuration (MeteoritePool,
+checkCollisions, GameSession, PlayGame) is compiled once per preset with its number of meteorites, screen bounds and
+radius range as constants. A preset inherits the values here and changes the ones it needs. A meteoriteCount of 0
+means the number comes from the difficulty values at run time, which is what CustomConfig is for
+Author: Andrew Popa
+*/
+struct GameConfig {
+    static constexpr int meteoriteCount = 0;
+    static constexpr int screenWidth = 320;
+    static constexpr int screenHeight = 240;
+    static constexpr int radiusMin = 4;                 //Meteorite min radius
+    static constexpr int radiusMax = 14;                //Meteorite max radius
+    static constexpr int playerRadius = 6;
+    static constexpr int playerHeight = 6;              //How many pixels from bottom of screen player is raised by
+    static constexpr int speedIncreaseSeconds = 1;      //Seconds between speed increases
+    static constexpr float speedStart = 0.5f;           //the initial speed
+    static constexpr float speedIncreaseAmount = 0.0075f; //Percentage speed the game increases by
+    static constexpr float deathMin = 0.2f;             //20% of life cicles
+    static constexpr float deathMax = 0.8f;             //80% of life cicles
+    static constexpr float speedMin = 0.75f;            //Percentage of gameSpeed
+    static constexpr float speedMax = 1.25f;            //Percentage of gameSpeed
+};
+
+//Presets of the game. Easy and hard are the menu's difficulties, stress is for measuring many meteorites
+struct EasyConfig : GameConfig { static constexpr int meteoriteCount = 25; };
+struct HardConfig : GameConfig { static constexpr int meteoriteCount = 50; };
+struct StressConfig : GameConfig { static constexpr int meteoriteCount = METEORITES_STRESS; };
+//Any other number of meteorites, such as the batch simulator's parameter files
+typedef GameConfig CustomConfig;
+
+/*
+Description: Random number generator owned by a game (PCG32), so a game can be played again with the same meteorites
+from its seed on any platform, unlike the global Random
+Private: generator state
+Public: Constructor, Seed function, Next function, NextFloat function, NextInt function
+Author: Andrew Popa
+*/
+class GameRandom {
+    unsigned long long state;
+public:
+    /*
+    Description: Constructor that seeds the generator
+    Input: Seed
+    Output: N/A
+    Author: Andrew Popa
+    */
+    GameRandom (unsigned int seed) {
+        Seed(seed);
+    }
+
+    /*
+    Description: Restarts the sequence of numbers for a seed
+    Input: Seed
+    Output: N/A
+    Author: Andrew Popa
+    */
+    void Seed(unsigned int seed) {
+        state = 0;
+        Next();
+        state += seed;
+        Next();
+    }
+
+    /*
+    Description: Advances the generator and returns the next number
+    Input: N/A
+    Output: Random 32 bit number
+    Author: Andrew Popa
+    */
+    unsigned int Next() {
+        unsigned long long old = state;
+        state = old * 6364136223846793005ULL + 1442695040888963407ULL;
+        //Permute the old state with an xorshift and a rotation that depends on its top bits
+        unsigned int xorShifted = (unsigned int)(((old >> 18) ^ old) >> 27);
+        unsigned int rotation = (unsigned int)(old >> 59);
+        return (xorShifted >> rotation) | (xorShifted << ((32 - rotation) & 31));
+    }
+
+    /*
+    Description: Returns a random float
+    Input: N/A
+    Output: Random float from 0 up to but not including 1
+    Author: Andrew Popa
+    */
+    float NextFloat() {
+        return (Next() >> 8) * (1.0f / 16777216.0f);
+    }
+
+    /*
+    Description: Returns a random integer in a range
+    Input: Lowest and highest value
+    Output: Random integer from low to high, both included
+    Author: Andrew Popa
+    */
+    int NextInt(int low, int high) {
+        return low + (int)(((unsigned long long)Next() * (unsigned int)(high - low + 1)) >> 32);
+    }
+};
+
+/*
+Description: Difficulty values of a game. The game uses the values of its configuration, the batch simulator tries others
+Author: Andrew Popa
+*/
+struct GameTuning {
+    int meteoriteCount;         //Number of meteorites
+    float speedStart;           //the initial speed
+    float speedIncreaseAmount;  //Speed added every speedIncreaseSeconds of the configuration
+    float deathMin, deathMax;   //Shortest and longest respawn delay, as a share of the meteorite's cycles on screen
+    float speedMin, speedMax;   //Meteorite speed as a share of the game speed
+};
+
+/*
+Description: Returns the difficulty values of a configuration
+Input: Number of meteorites, only used when the configuration does not set it
+Output: Difficulty values
+Author: Andrew Popa
+*/
+template <class Config>
+GameTuning ConfigTuning(int meteoriteCount) {
+    if (Config::meteoriteCount > 0)
+        meteoriteCount = Config::meteoriteCount;
+    GameTuning tuning = {meteoriteCount, Config::speedStart, Config::speedIncreaseAmount, Config::deathMin,
+        Config::deathMax, Config::speedMin, Config::speedMax};
+    return tuning;
+}
+
+/*
+Description: Picks the seed of a new game from the clock and the global Random
+Input: N/A
+Output: Seed
+Author: Andrew Popa
+*/
+unsigned int NewGameSeed() {
+    return TimeNowMSec() * 2654435761u ^ (unsigned int)Random.RandInt() << 16 ^ (unsigned int)Random.RandInt();
+}
+
+#define SESSION_ARENA_BYTES 16384       //Starting size of a game's arena, it grows to fit the largest game played
+
+/*
+Description: Arena that all of a game's arrays (meteorites, collision candidates, dirty areas) are taken from. Taking
+memory only moves a counter, and the whole arena is emptied at once when the game ends, so games never call the
+allocator while playing and memory stays the same over any number of games. If a game needs more than the block,
+the extra comes from overflow blocks, and at the next Reset the block grows to the high-water mark so it fits from
+then on
+Private: block, its capacity, bytes used in it, overflow blocks, bytes taken from them
+Public: high-water mark, times grown, Constructor, Deconstructor, Allocate function, AllocateArray function, Reset
+function, Used function, Capacity function
+Author: Andrew Popa
+*/
+class Arena {
+    unsigned char *pBlock;
+    unsigned long capacity, used;
+    //Each overflow block starts with the pointer to the next one, padded to ARENA_ALIGN
+    unsigned char *pOverflow;
+    unsigned long overflowUsed;
+
+    /*
+    Description: Frees every overflow block
+    Input: N/A
+    Output: N/A
+    Author: Andrew Popa
+    */
+    void FreeOverflow() {
+        while (pOverflow) {
+            unsigned char *pNext = *(unsigned char **)pOverflow;
+            delete[] pOverflow;
+            pOverflow = pNext;
+        }
+        overflowUsed = 0;
+    }
+
+public:
+    unsigned long highWater;
+    int grows;
+
+    /*
+    Description: Constructor that creates the block
+    Input: Starting capacity in bytes
+    Output: N/A
+    Author: Andrew Popa
+    */
+    Arena (unsigned long _capacity = SESSION_ARENA_BYTES) {
+        capacity = _capacity;
+        pBlock = new unsigned char[capacity];
+        used = overflowUsed = highWater = 0;
+        pOverflow = NULL;
+        grows = 0;
+    }
+
+    /*
+    Description: Deconstructor that frees the block and any overflow blocks
+    Input: N/A
+    Output: N/A
+    Author: Andrew Popa
+    */
+    ~Arena () {
+        FreeOverflow();
+        delete[] pBlock;
+    }
+
+    /*
+    Description: Takes memory from the arena, aligned for any of the game's arrays. It is not constructed or zeroed
+    Input: Number of bytes
+    Output: Pointer to the memory, valid until Reset
+    Author: Andrew Popa
+    */
+    void *Allocate(unsigned long bytes) {
+        unsigned long start = (used + 15) & ~15ul;
+        if (start + bytes <= capacity) {
+            used = start + bytes;
+            return pBlock + start;
+        }
+        unsigned char *pExtra = new unsigned char[16 + bytes];
+        *(unsigned char **)pExtra = pOverflow;
+        pOverflow = pExtra;
+        overflowUsed += bytes;
+        return pExtra + 16;
+    }
+
+    /*
+    Description: Takes an array from the arena, only for types that need no constructor
+    Input: Number of elements
+    Output: Pointer to the array, valid until Reset
+    Author: Andrew Popa
+    */
+    template <class T>
+    T *AllocateArray(int count) {
+        return (T *)Allocate(count * sizeof(T));
+    }
+
+    /*
+    Description: Empties the arena, updating the high-water mark. If overflow blocks were needed they are freed and
+    the block grows to the high-water mark, otherwise this only resets a counter
+    Input: N/A
+    Output: N/A
+    Author: Andrew Popa
+    */
+    void Reset() {
+        if (Used() > highWater)
+            highWater = Used();
+        if (pOverflow) {
+            FreeOverflow();
+            delete[] pBlock;
+            //Leave room for the alignment of each array
+            capacity = highWater + highWater / 4;
+            pBlock = new unsigned char[capacity];
+            grows++;
+        }
+        used = 0;
+    }
+
+    /*
+    Description: Bytes taken since the last Reset, including overflow blocks
+    Input: N/A
+    Output: Bytes used
+    Author: Andrew Popa
+    */
+    unsigned long Used() {
+        return used + overflowUsed;
+    }
+
+    /*
+    Description: Size of the block
+    Input: N/A
+    Output: Capacity in bytes
+    Author: Andrew Popa
+    */
+    unsigned long Capacity() {
+        return capacity;
+    }
+};
+
+//Arena of the game being played
+Arena GameArena;
+
+/*
+Description: Keeps a list of the screen areas drawn over the background during a frame so the next frame only
+has to repaint those areas from the background instead of clearing and redrawing the whole screen
+Private: array of rectangles, capacity, number of rectangles
+Public: Constructor, Add function, CopiesAreas function, Restore function
+Author: Andrew Popa
+*/
+class DirtyRegions {
+    Rect *rects;
+    int capacity, count;
+public:
+    /*
+    Description: Constructor that starts with no dirty areas
+    Input: Maximum number of areas recorded in a frame, arena the list is taken from
+    Output: N/A
+    Author: Andrew Popa
+    */
+    DirtyRegions (int _capacity, Arena &arena) {
+        capacity = _capacity;
+        rects = arena.AllocateArray<Rect>(capacity);
+        count = 0;
+    }
+
+    /*
+    Description: Records an area that was drawn over, clipped to the screen
+    Input: Top left x and y coordinate, width and height of the area
+    Output: N/A
+    Author: Andrew Popa
+    */
+    void Add(int x, int y, int width, int height) {
+        if (x < 0) { width += x; x = 0; }
+        if (y < 0) { height += y; y = 0; }
+        if (x + width > GameConfig::screenWidth) width = GameConfig::screenWidth - x;
+        if (y + height > GameConfig::screenHeight) height = GameConfig::screenHeight - y;
+        //Ignore areas that are off the screen, and stop recording if the list is full
+        if (width <= 0 || height <= 0 || count == capacity)
+            return;
+        Rect rect = {x, y, width, height};
+        rects[count++] = rect;
+    }
+
+    /*
+    Description: Checks if areas can be copied out of a background: it has pixels for the whole screen. A
+    background that did not load has none, and neither does one the stock library decoded instead of the atlas
+    Input: Background image
+    Output: True if Restore copies only the recorded areas, false if it redraws the whole screen
+    Author: Andrew Popa
+    */
+    bool CopiesAreas(Asset &background) {
+        return background.Pixels() && background.Width() >= GameConfig::screenWidth &&
+            background.Height() >= GameConfig::screenHeight;
+    }
+
+    /*
+    Description: Repaints every recorded area from the background and empties the list
+    Input: Background image of the game, which covers the whole screen
+    Output: N/A, repaints the screen
+    Author: Andrew Popa
+    */
+    void Restore(Asset &background) {
+        //Copy each area straight out of the background's pixels, in runs of one colour without block copies
+        if (CopiesAreas(background)) {
+            for (int i = 0; i < count; i++) {
+                const unsigned short *pArea = background.Pixels() + rects[i].y * background.Stride() + rects[i].x;
+#ifdef FEHLCD_HAS_BLIT
+                LCD.Blit(rects[i].x, rects[i].y, rects[i].width, rects[i].height, pArea, background.Stride());
+#else
+                PaintRuns(rects[i].x, rects[i].y, rects[i].width, rects[i].height, pArea, background.Stride(), false);
+#endif
+            }
+            count = 0;
+            return;
+        }
+#ifdef FEHLCD_HAS_BLIT
+        //Here a background without pixels for the whole screen did not load, and may not cover what was drawn
+        if (count > 0)
+            LCD.Clear(BLACK);
+#endif
+        //Otherwise the stock library decoded it, and the only way back to the background is to redraw all of it
+        if (count > 0)
+            background.Draw(0, 0);
+        count = 0;
+    }
+};
+
+#ifndef FRAME_BUDGET_MS
+#define FRAME_BUDGET_MS 9.0             //Work a game frame may take before detail is dropped, can be changed when building
+#endif
+#define GOVERNOR_WINDOW 30              //Frames averaged for each decision of the quality governor
+#define GOVERNOR_HEADROOM 0.5           //Part of the budget the mean frame has to stay under for detail to come back
+#define GOVERNOR_RECOVER_WINDOWS 4      //Windows in a row with headroom before detail comes back
+#define QUALITY_LOG_SIZE 16             //Level changes of a game kept in memory, older ones are overwritten
+#define QUALITY_LOG_FILE "quality.log"  //The level changes of every game that had any are appended to this file
+
+//Levels of detail the game is drawn with, each drops the detail of the one before it as well
+enum QualityLevel { QUALITY_FULL, QUALITY_NO_SHADOWS, QUALITY_NO_OUTLINE, QUALITY_HALF_RATE, QUALITY_COUNT };
+const char *qualityNames[QUALITY_COUNT] = {"full", "no meteorite shadows", "no player outline", "every other frame drawn"};
+
+/*
+Description: One change of the quality level, kept by the governor until the game ends
+Author: Andrew Popa
+*/
+struct QualityChange {
+    unsigned long frame;                //Frame of the game the window ended on
+    float meanMs;                       //Mean work of the window's frames
+    unsigned char from, to;             //Levels before and after
+};
+
+/*
+Description: Keeps game frames inside FRAME_BUDGET_MS by dropping detail when they take longer. Every
+GOVERNOR_WINDOW frames the mean time of the window's frames is compared with the budget: over it, the quality drops
+a level; under GOVERNOR_HEADROOM of it for GOVERNOR_RECOVER_WINDOWS windows in a row, it comes back a level. The two
+thresholds and the wait keep the quality from flipping between levels. Every change is kept in a small ring buffer
+and written to QUALITY_LOG_FILE after the game, on the Proteus as well as the headless build
+Private: level, frames and time of the window, windows in a row with headroom, frames of the game, last changes
+Public: changes, Constructor, Reset function, Level function, Shadows function, PlayerOutline function, DrawFrame
+function, EndFrame function, WriteLog function
+Author: Andrew Popa
+*/
+class QualityGovernor {
+    int level;
+    int windowFrames;
+    double windowSeconds;
+    int calmWindows;
+    unsigned long frames;
+    QualityChange log[QUALITY_LOG_SIZE];
+public:
+    int changes;
+
+    /*
+    Description: Constructor that starts at full quality
+    Input: N/A
+    Output: N/A
+    Author: Andrew Popa
+    */
+    QualityGovernor () {
+        Reset();
+    }
+
+    /*
+    Description: Goes back to full quality for a new game
+    Input: N/A
+    Output: N/A
+    Author: Andrew Popa
+    */
+    void Reset() {
+        level = QUALITY_FULL;
+        windowFrames = 0;
+        windowSeconds = 0;
+        calmWindows = 0;
+        frames = 0;
+        changes = 0;
+    }
+
+    /*
+    Description: Gets the current quality level, QUALITY_FULL being the highest
+    Input: N/A
+    Output: The level
+    Author: Andrew Popa
+    */
+    int Level() { return level; }
+
+    /*
+    Description: Checks if meteorites are drawn with their shadows at the current level
+    Input: N/A
+    Output: True if the shadows are drawn
+    Author: Andrew Popa
+    */
+    bool Shadows() { return level < QUALITY_NO_SHADOWS; }
+
+    /*
+    Description: Checks if the player is drawn with its outline at the current level
+    Input: N/A
+    Output: True if the outline is drawn
+    Author: Andrew Popa
+    */
+    bool PlayerOutline() { return level < QUALITY_NO_OUTLINE; }
+
+    /*
+    Description: Checks if this frame is drawn. At the lowest level only every other frame repaints the background
+    and objects, the game still runs every tick
+    Input: N/A
+    Output: True if the frame is drawn
+    Author: Andrew Popa
+    */
+    bool DrawFrame() {
+        return level < QUALITY_HALF_RATE || frames % 2 == 0;
+    }
+
+    /*
+    Description: Adds a frame's time to the window, and at the end of the window changes the level if needed
+    Input: Time the frame took, without sleeping
+    Output: N/A
+    Author: Andrew Popa
+    */
+    void EndFrame(double seconds) {
+        frames++;
+        windowSeconds += seconds;
+        if (++windowFrames < GOVERNOR_WINDOW)
+            return;
+        double meanMs = windowSeconds * 1000 / windowFrames;
+        windowFrames = 0;
+        windowSeconds = 0;
+        int oldLevel = level;
+        if (meanMs > FRAME_BUDGET_MS) {
+            calmWindows = 0;
+            if (level < QUALITY_COUNT - 1)
+                level++;
+        } else if (meanMs < FRAME_BUDGET_MS * GOVERNOR_HEADROOM) {
+            if (++calmWindows >= GOVERNOR_RECOVER_WINDOWS && level > QUALITY_FULL) {
+                level--;
+                calmWindows = 0;
+            }
+        } else {
+            calmWindows = 0;
+        }
+        if (level != oldLevel) {
+            QualityChange &change = log[changes % QUALITY_LOG_SIZE];
+            change.frame = frames;
+            change.meanMs = (float)meanMs;
+            change.from = oldLevel;
+            change.to = level;
+            changes++;
+#ifdef FEH_HEADLESS
+            fprintf(stderr, "quality: frame %lu, mean %.3f ms against %.3f ms, %s to %s\n", frames, meanMs,
+                (double)FRAME_BUDGET_MS, level > oldLevel ? "dropped" : "raised", qualityNames[level]);
+#endif
+        }
+    }
+
+    /*
+    Description: Appends the level changes of the game to a text file, one line each, oldest first. Nothing is written
+    for a game that stayed at full quality
+    Input: File name, seed of the game
+    Output: False if the file could not be written
+    Author: Andrew Popa
+    */
+    bool WriteLog(const char *fileName, unsigned int seed) {
+        if (changes == 0)
+            return true;
+        FILE *pFile = fopen(fileName, "a");
+        if (!pFile)
+            return false;
+        fprintf(pFile, "game %u: %d changes against %.3f ms\n", seed, changes, (double)FRAME_BUDGET_MS);
+        int first = changes > QUALITY_LOG_SIZE ? changes - QUALITY_LOG_SIZE : 0;
+        if (first > 0)
+            fprintf(pFile, "  %d older changes not kept\n", first);
+        for (int i = first; i < changes; i++) {
+            QualityChange &change = log[i % QUALITY_LOG_SIZE];
+            fprintf(pFile, "  frame %lu, mean %.3f ms, %s to %s\n", change.frame, change.meanMs,
+                qualityNames[change.from], qualityNames[change.to]);
+        }
+        fclose(pFile);
+        return true;
+    }
+};
+
+QualityGovernor Quality;
+
+/*
+Description: Records the three circles of a meteorite, its black and dark shadows offset up and to the right. The
+shadows are on their own layers, so with many meteorites every black shadow is drawn first, then every dark shadow,
+then every meteorite
+Input: x and y coordinate of the center, radius, false to leave out the shadows
+Output: N/A, drawn when the draw list is submitted
+Author: Andrew Popa
+*/
+void PaintMeteorite(int x, int y, int r, bool bShadows = true) {
+    if (bShadows) {
+        Canvas.FillCircle(LAYER_SHADOW_FAR, BLACK, x + 2, y - 2, r);
+        Canvas.FillCircle(LAYER_SHADOW_NEAR, DARKSLATEGRAY, x + 1, y - 1, r);
+    }
+    Canvas.FillCircle(LAYER_METEORITES, LIGHTSLATEGRAY, x, y, r);
+}
+
+/*
+Description: Records all parts of the player
+Input: x and y coordinate of the center of the player, false to leave out the outline
+Output: N/A, drawn when the draw list is submitted
+Author: Andrew Popa
+*/
+void PaintPlayer(int x, int y, bool bOutline = true) {
+    Canvas.FillCircle(LAYER_PLAYER, YELLOWGREEN, x, y, GameConfig::playerRadius);
+    Canvas.Pixel(LAYER_PLAYER_DETAIL, BLUEVIOLET, x - 2, y - 3);
+    Canvas.Pixel(LAYER_PLAYER_DETAIL, BLUEVIOLET, x + 2, y - 3);
+    Canvas.HorizontalLine(LAYER_PLAYER_DETAIL, BLUEVIOLET, y + 2, x - 3, x + 4);
+    if (bOutline)
+        Canvas.Circle(LAYER_PLAYER_DETAIL, BLUEVIOLET, x, y, GameConfig::playerRadius);
+}
+
+#define METEORITE_SPRITE_SIZE (2 * GameConfig::radiusMax + 3)    //Meteorite plus its shadows, 2 pixels wider and taller
+#define PLAYER_SPRITE_SIZE (2 * GameConfig::playerRadius + 1)
+
+/*
+Description: Sprite cache that draws every meteorite size and the player once into small images at the start of the
+game, so each frame draws an object with one masked copy instead of drawing its circles again. The meteorite sprite
+of radius r is (2r + 3) pixels wide and tall, with the meteorite's center at (r, r + 2). Without block copies in the
+LCD library the objects are drawn directly instead. Meteorites without shadows and the player without the outline
+have sprites of their own, for when the quality governor drops that detail
+Private: meteorite sprites by radius with and without shadows, player sprites with and without the outline, built flag
+Public: Constructor, Build function, DrawMeteorite function, DrawPlayer function
+Author: Andrew Popa
+*/
+class SpriteCache {
+#ifdef FEHLCD_HAS_BLIT
+    unsigned short meteorites[2][GameConfig::radiusMax - GameConfig::radiusMin + 1][METEORITE_SPRITE_SIZE * METEORITE_SPRITE_SIZE];
+    unsigned short player[2][PLAYER_SPRITE_SIZE * PLAYER_SPRITE_SIZE];
+#endif
+    bool bBuilt;
+public:
+    /*
+    Description: Constructor, the sprites are drawn later by Build
+    Input: N/A
+    Output: N/A
+    Author: Andrew Popa
+    */
+    SpriteCache () {
+        bBuilt = false;
+    }
+
+    /*
+    Description: Draws every sprite once by sending the drawing to the sprite images instead of the screen. Does
+    nothing after the first call
+    Input: N/A
+    Output: N/A
+    Author: Andrew Popa
+    */
+    void Build() {
+        if (bBuilt)
+            return;
+#ifdef FEHLCD_HAS_BLIT
+        //Index 0 has all the detail, index 1 leaves out the shadows and the outline
+        for (int detail = 0; detail < 2; detail++) {
+            for (int r = GameConfig::radiusMin; r <= GameConfig::radiusMax; r++) {
+                int size = 2 * r + 3;
+                LCD.SetRenderTarget(meteorites[detail][r - GameConfig::radiusMin], size, size);
+                LCD.Clear(LCD.FromNative(SPRITE_KEY));
+                PaintMeteorite(r, r + 2, r, detail == 0);
+                Canvas.Submit();
+            }
+            LCD.SetRenderTarget(player[detail], PLAYER_SPRITE_SIZE, PLAYER_SPRITE_SIZE);
+            LCD.Clear(LCD.FromNative(SPRITE_KEY));
+            PaintPlayer(GameConfig::playerRadius, GameConfig::playerRadius, detail == 0);
+            Canvas.Submit();
+        }
+        LCD.SetRenderTarget(NULL, 0, 0);
+#endif
+        bBuilt = true;
+    }
+
+    /*
+    Description: Records a meteorite and its shadows into the draw list, without the shadows if the quality
+    governor dropped them
+    Input: x and y coordinate of the center, radius
+    Output: N/A, drawn when the draw list is submitted
+    Author: Andrew Popa
+    */
+    void DrawMeteorite(int x, int y, int r) {
+#ifdef FEHLCD_HAS_BLIT
+        int size = 2 * r + 3;
+        Canvas.Sprite(LAYER_METEORITES, x - r, y - r - 2, size, size, meteorites[Quality.Shadows() ? 0 : 1][r - GameConfig::radiusMin],
+            SPRITE_KEY);
+#else
+        PaintMeteorite(x, y, r, Quality.Shadows());
+#endif
+    }
+
+    /*
+    Description: Records the player into the draw list, without the outline if the quality governor dropped it
+    Input: x and y coordinate of the center of the player
+    Output: N/A, drawn when the draw list is submitted
+    Author: Andrew Popa
+    */
+    void DrawPlayer(int x, int y) {
+#ifdef FEHLCD_HAS_BLIT
+        Canvas.Sprite(LAYER_PLAYER, x - GameConfig::playerRadius, y - GameConfig::playerRadius, PLAYER_SPRITE_SIZE, PLAYER_SPRITE_SIZE,
+            player[Quality.PlayerOutline() ? 0 : 1], SPRITE_KEY);
+#else
+        PaintPlayer(x, y, Quality.PlayerOutline());
+#endif
+    }
+};
+
+SpriteCache Sprites;
+
+/*
+Description: Records a meteorite's sprite and adds the area it covers to the dirty regions
+Input: Dirty regions of the frame, x and y coordinate of the center, radius
+Output: N/A
+Author: Andrew Popa
+*/
+void DrawMeteoriteSprite(DirtyRegions &dirty, int x, int y, int r) {
+    Sprites.DrawMeteorite(x, y, r);
+    //The shadows are offset 2 pixels right and up of the meteorite
+    dirty.Add(x - r, y - r - 2, 2 * r + 3, 2 * r + 3);
+}
+
+/*
+Description: Records the player's sprite and adds the area it covers to the dirty regions
+Input: Dirty regions of the frame, x and y coordinate of the center of the player
+Output: N/A
+Author: Andrew Popa
+*/
+void DrawPlayerSprite(DirtyRegions &dirty, int x, int y) {
+    Sprites.DrawPlayer(x, y);
+    dirty.Add(x - GameConfig::playerRadius, y - GameConfig::playerRadius, 2 * GameConfig::playerRadius + 1, 2 * GameConfig::playerRadius + 1);
+}
+
+/*
+Description: Moves every meteorite that is marked as moving by its speed. Kept as a separate loop over plain
+arrays with no branches so the compiler can vectorize it
+Input: y coordinates, speeds, moving flags, number of meteorites
+Output: N/A, changes the y coordinates
+Author: Andrew Popa
+*/
+void AdvanceMeteorites(float *__restrict y, const float *__restrict speed, const unsigned char *__restrict moving, int count) {
+    for (int i = 0; i < count; i++)
+        y[i] += speed[i] * moving[i];
+}
+
+#define PARTICLE_CAPACITY 256       //Particles alive at once, more are dropped
+#define PARTICLE_BUDGET 64          //Particles that can start in one frame, more are dropped
+#define PARTICLE_GRAVITY 0.08f      //Pixels per tick added to a particle's fall speed every tick
+#define DEBRIS_PARTICLES 4          //Particles thrown up by a meteorite hitting the ground
+#define EXPLOSION_PARTICLES 60      //Particles of the explosion when the player is hit
+#define EXPLOSION_FRAMES 60         //Ticks of SLEEP_MS the game loop keeps running for the explosion
+#define EFFECTS_SEED 0x9E3779B9      //Mixed into the game's seed for the effects' random numbers
+
+/*
+Description: Advances every live particle one frame: gravity is added to its y speed before it moves, so it falls
+faster each frame, and its life goes down by one. Dead particles are removed by the caller afterwards, so this pass
+only touches the coordinate, speed and life arrays
+Input: x and y coordinates, x and y speeds, lives, number of particles
+Output: N/A, changes the particles
+Author: Andrew Popa
+*/
+void AdvanceParticles(float *__restrict x, float *__restrict y, const float *__restrict vx, float *__restrict vy,
+        int *__restrict life, int count) {
+    for (int i = 0; i < count; i++) {
+        vy[i] += PARTICLE_GRAVITY;
+        x[i] += vx[i];
+        y[i] += vy[i];
+        life[i]--;
+    }
+}
+
+/*
+Description: Records particles into the draw list, from the particle system or from a snapshot of it
+Input: Dirty regions of the frame, where the area each particle is drawn over is added, x and y coordinates,
+colours, radii, number of particles
+Output: N/A, drawn when the draw list is submitted
+Author: Andrew Popa
+*/
+void PaintParticles(DirtyRegions &dirty, const float *x, const float *y, const unsigned int *colour,
+        const unsigned char *size, int count) {
+    for (int i = 0; i < count; i++) {
+        int px = (int)x[i], py = (int)y[i], r = size[i];
+        Canvas.FillCircle(LAYER_EFFECTS, colour[i], px, py, r);
+        dirty.Add(px - r, py - r, 2 * r + 1, 2 * r + 1);
+    }
+}
+
+/*
+Description: Counters of the particle system
+Author: Andrew Popa
+*/
+struct ParticleStats {
+    unsigned long spawned;              //Particles started
+    unsigned long overBudget;           //Particles dropped because the frame's budget was used up
+    unsigned long poolFull;             //Particles dropped because every particle was alive
+    int maxAlive;                       //Most particles alive at once
+};
+
+/*
+Description: Pool of short lived particles for the game's effects: the debris of meteorites hitting the ground and
+the explosion when the player is hit. The particles are kept in one array per value, with the living ones at the
+front, and are all moved in one batch per tick. The arrays are taken from the game's arena and hold at most
+PARTICLE_CAPACITY particles, and at most PARTICLE_BUDGET start per frame, so the cost of a frame's effects is
+bounded. It has its own random number generator, so effects never change the meteorites of a game
+Private: arrays of x, y, x speed, y speed, life, colour and size, number alive, number started this frame, random
+number generator, Spawn function, Burst function
+Public: stats, Constructor, Count function, BeginFrame function, Debris function, Explode function, Update function,
+Copy function, Draw function
+Author: Andrew Popa
+*/
+class ParticleSystem {
+    float *x, *y, *vx, *vy;
+    int *life;
+    unsigned int *colour;
+    unsigned char *size;
+    int count, frameSpawned;
+    GameRandom random;
+
+    /*
+    Description: Starts a particle if the pool and the frame's budget have room
+    Input: x and y coordinate, x and y speed, ticks it lives, colour, radius
+    Output: N/A
+    Author: Andrew Popa
+    */
+    void Spawn(float _x, float _y, float _vx, float _vy, int _life, unsigned int _colour, int _size) {
+        if (frameSpawned == PARTICLE_BUDGET) {
+            stats.overBudget++;
+            return;
+        }
+        if (count == PARTICLE_CAPACITY) {
+            stats.poolFull++;
+            return;
+        }
+        x[count] = _x;
+        y[count] = _y;
+        vx[count] = _vx;
+        vy[count] = _vy;
+        life[count] = _life;
+        colour[count] = _colour;
+        size[count] = _size;
+        count++;
+        frameSpawned++;
+        stats.spawned++;
+        if (count > stats.maxAlive)
+            stats.maxAlive = count;
+    }
+
+    /*
+    Description: Starts particles flying out of a point in random directions
+    Input: x and y coordinate, number of particles, fastest speed, fewest and most ticks they live, colour, radius,
+    true to only throw them upwards
+    Output: N/A
+    Author: Andrew Popa
+    */
+    void Burst(float _x, float _y, int number, float speedMax, int lifeMin, int lifeMax, unsigned int _colour, int _size,
+            bool bUpwards) {
+        for (int i = 0; i < number; i++) {
+            float angle = random.NextFloat() * (bUpwards ? 3.14159f : 6.28318f);
+            float particleSpeed = speedMax * (0.25f + 0.75f * random.NextFloat());
+            Spawn(_x, _y, particleSpeed * cosf(angle), -particleSpeed * sinf(angle),
+                random.NextInt(lifeMin, lifeMax), _colour, _size);
+        }
+    }
+
+public:
+    ParticleStats stats;
+
+    /*
+    Description: Constructor that takes the particle arrays from the game's arena
+    Input: Seed of the effects, arena of the game
+    Output: N/A
+    Author: Andrew Popa
+    */
+    ParticleSystem (unsigned int seed, Arena &arena) : random(seed) {
+        x = arena.AllocateArray<float>(PARTICLE_CAPACITY);
+        y = arena.AllocateArray<float>(PARTICLE_CAPACITY);
+        vx = arena.AllocateArray<float>(PARTICLE_CAPACITY);
+        vy = arena.AllocateArray<float>(PARTICLE_CAPACITY);
+        life = arena.AllocateArray<int>(PARTICLE_CAPACITY);
+        colour = arena.AllocateArray<unsigned int>(PARTICLE_CAPACITY);
+        size = arena.AllocateArray<unsigned char>(PARTICLE_CAPACITY);
+        count = 0;
+        frameSpawned = 0;
+        stats.spawned = stats.overBudget = stats.poolFull = 0;
+        stats.maxAlive = 0;
+    }
+
+    /*
+    Description: Returns the number of particles alive
+    Input: N/A
+    Output: Number of particles
+    Author: Andrew Popa
+    */
+    int Count() {
+        return count;
+    }
+
+    /*
+    Description: Starts a new frame's budget of particles, however many ticks the frame runs and whether it is drawn
+    Input: N/A
+    Output: N/A
+    Author: Andrew Popa
+    */
+    void BeginFrame() {
+        frameSpawned = 0;
+    }
+
+    /*
+    Description: Throws up the debris of a meteorite that hit the ground, in the meteorite's colours
+    Input: x coordinate of the meteorite, y coordinate of the ground, radius of the meteorite
+    Output: N/A
+    Author: Andrew Popa
+    */
+    void Debris(float _x, float ground, int r) {
+        Burst(_x, ground, DEBRIS_PARTICLES / 2, 0.3f + 0.1f * r, 10, 30, LIGHTSLATEGRAY, 1, true);
+        Burst(_x, ground, DEBRIS_PARTICLES / 2, 0.3f + 0.1f * r, 10, 30, DARKSLATEGRAY, 1, true);
+    }
+
+    /*
+    Description: Starts the explosion of the player, in the colours of the old expanding circles: a few large
+    tomato particles, then red and dark red ones that fly further and live longer
+    Input: x and y coordinate of the player
+    Output: N/A
+    Author: Andrew Popa
+    */
+    void Explode(float _x, float _y) {
+        Burst(_x, _y, EXPLOSION_PARTICLES / 4, 1.5f, 15, 30, TOMATO, 3, false);
+        Burst(_x, _y, EXPLOSION_PARTICLES / 4, 2.5f, 25, 45, RED, 2, false);
+        Burst(_x, _y, EXPLOSION_PARTICLES / 2, 3.5f, 35, EXPLOSION_FRAMES, DARKRED, 1, false);
+    }
+
+    /*
+    Description: Runs one tick for all particles, then removes the ones that died or left the screen by moving the
+    last living particle into their place
+    Input: N/A
+    Output: N/A
+    Author: Andrew Popa
+    */
+    void Update() {
+        AdvanceParticles(x, y, vx, vy, life, count);
+        for (int i = 0; i < count; ) {
+            if (life[i] > 0 && y[i] < GameConfig::screenHeight + size[i] && x[i] > -size[i] &&
+                    x[i] < GameConfig::screenWidth + size[i]) {
+                i++;
+                continue;
+            }
+            count--;
+            x[i] = x[count];
+            y[i] = y[count];
+            vx[i] = vx[count];
+            vy[i] = vy[count];
+            life[i] = life[count];
+            colour[i] = colour[count];
+            size[i] = size[count];
+        }
+    }
+
+    /*
+    Description: Copies the position, colour and radius of every particle, for drawing on another thread
+    Input: Arrays the x and y coordinates, colours and radii are written to, at least PARTICLE_CAPACITY long
+    Output: Number of particles copied
+    Author: Andrew Popa
+    */
+    int Copy(float *pX, float *pY, unsigned int *pColour, unsigned char *pSize) {
+        memcpy(pX, x, count * sizeof(*x));
+        memcpy(pY, y, count * sizeof(*y));
+        memcpy(pColour, colour, count * sizeof(*colour));
+        memcpy(pSize, size, count * sizeof(*size));
+        return count;
+    }
+
+    /*
+    Description: Records every particle into the draw list
+    Input: Dirty regions of the frame, where the area each particle is drawn over is added
+    Output: N/A, drawn when the draw list is submitted
+    Author: Andrew Popa
+    */
+    void Draw(DirtyRegions &dirty) {
+        PaintParticles(dirty, x, y, colour, size, count);
+    }
+};
+
+/*
+Description: Counters of the collision checks, used to see how much work the broad phase saves
+Author: Andrew Popa
+*/
+struct CollisionStats {
+    unsigned long checks;       //Number of times collisions were checked
+    unsigned long scanned;      //Meteorites looked at by the broad phase
+    unsigned long pairsTested;  //Meteorites that passed the broad phase and had their distance checked
+};
+
+/*
+Description: Broad phase of the collision check. The player only lives in a thin band at the bottom of the screen,
+so only meteorites whose y coordinate is within reach of the player's are kept. Written without branches (the
+index is always stored, but only counted if it passed) because most meteorites fail the test
+Input: y and radius of the player, meteorite y coordinates and radii, number of meteorites, array the indexes of the
+meteorites in reach are written to
+Output: Number of meteorites in reach
+Author: Andrew Popa
+*/
+int GatherBandCandidates(float py, float pr, const float *__restrict y, const int *__restrict r, int count,
+    int *__restrict candidates) {
+    int found = 0;
+    for (int i = 0; i < count; i++) {
+        float dy = py - y[i], reach = pr + r[i];
+        candidates[found] = i;
+        found += (dy <= reach) & (dy >= -reach);
+    }
+    return found;
+}
+
+/*
+Description: Collision subsystem between the player and the meteorites. A cheap broad phase keeps only the meteorites
+near the player's height, then the narrow phase uses the pythagorean theorem on those, comparing the squared distance
+with the squared sum of the radii so no square root is needed, and stops at the first hit
+Private: array of candidate indexes, capacity
+Public: stats, Constructor, Check function
+Author: Andrew Popa
+*/
+class CollisionSystem {
+    int *candidates;
+    int capacity;
+public:
+    CollisionStats stats;
+
+    /*
+    Description: Constructor that creates the candidate list and zeroes the counters
+    Input: Maximum number of meteorites checked, arena the list is taken from
+    Output: N/A
+    Author: Andrew Popa
+    */
+    CollisionSystem (int _capacity, Arena &arena) {
+        capacity = _capacity;
+        candidates = arena.AllocateArray<int>(capacity);
+        stats.checks = stats.scanned = stats.pairsTested = 0;
+    }
+
+    /*
+    Description: Checks if a circle touches any of the given meteorites
+    Input: x, y and radius of the circle, meteorite coordinates and radii, number of meteorites
+    Output: True if there is a collision, false otherwise
+    Author: Andrew Popa
+    */
+    bool Check(float px, float py, float pr, const float *x, const float *y, const int *r, int count) {
+        if (count > capacity)
+            count = capacity;
+        int found = GatherBandCandidates(py, pr, y, r, count, candidates);
+        stats.checks++;
+        stats.scanned += count;
+        for (int c = 0; c < found; c++) {
+            int i = candidates[c];
+            float dx = px - x[i], dy = py - y[i], reach = pr + r[i];
+            stats.pairsTested++;
+            if (dx * dx + dy * dy <= reach * reach)
+                return true;
+        }
+        return false;
+    }
+};
+
+#define SPAWN_WHEEL_SLOTS 256       //Ticks the spawn wheel covers in one turn, must be a power of 2
+
+/*
+Description: Pool that holds every meteorite of the game in separate arrays (one array per value) instead of one
+object per meteorite, so updating and collision checking walk contiguous memory and any number of meteorites fits.
+The meteorites on screen are kept at the front of the arrays, so every loop only walks those. Meteorites waiting to
+start or respawn sit on a spawn wheel: a ring of SPAWN_WHEEL_SLOTS lists, one per tick, each holding the meteorites
+that wake on that tick (or a whole number of turns later), so waiting costs nothing until the tick comes. The screen
+bounds and radius range come from the configuration it is compiled for.
+Controls the generation, movement, redrawing and respawning of the meteorites
+Private: difficulty values, random number generator, game speed, capacity, number of meteorites, number on screen,
+ticks run, arrays of x, y, speed, radius and moving flag by position, arrays of meteorite by position and position by
+meteorite, wake tick, respawn flag and next meteorite on the wheel, wheel slots, events of a tick
+Public: Constructor, Count function, ActiveCount function, SetGameSpeed function, Draw function, CopyFalling
+function, Update function, Collides function, Threat function
+Author: Andrew Popa
+*/
+template <class Config>
+class MeteoritePool {
+    //The sprite cache only has the sizes of the default configuration
+    static_assert(Config::radiusMin >= GameConfig::radiusMin && Config::radiusMax <= GameConfig::radiusMax,
+        "meteorite radius range does not fit the sprite cache");
+
+    const GameTuning &tuning;
+    GameRandom &random;
+    float gameSpeed;
+    int capacity, count, activeCount;
+    unsigned long tick;
+    //By position, the first activeCount positions are the meteorites on screen
+    float *x, *y, *speed;
+    int *r, *meteorite;
+    unsigned char *moving;
+    //By meteorite: its position, and when it is on the wheel the tick it wakes on, if it respawns (or just starts) and
+    //the next meteorite in the same slot, -1 at the end
+    int *position, *wheelNext;
+    unsigned long *wakeTick;
+    unsigned char *bRespawn;
+    int wheel[SPAWN_WHEEL_SLOTS];
+    int *events;
+
+    /*
+    Description: Resets a meteorite once it has passed the death event, with a random speed, size and position
+    Input: Position of the meteorite
+    Output: N/A, resets the meteorite position
+    Author: Andrew Popa
+    */
+    void resetMeteorite(int i) {
+        //Generates a random speed for each meteorite
+        speed[i] = gameSpeed * (tuning.speedMin + tuning.speedMax * random.NextFloat());
+        //radiusMax itself is left out, like the original RandInt() * (max - min) / RANDOM_MAX which almost never reached it
+        r[i] = random.NextInt(Config::radiusMin, Config::radiusMax - 1);
+        y[i] = r[i] + 2;
+        x[i] = random.NextInt(r[i], Config::screenWidth - 2 - r[i]);
+    }
+
+    /*
+    Description: Checks if a meteorite on screen is still above the ground, so it is drawn and moved
+    Input: Position of the meteorite
+    Output: True if the meteorite is falling this cycle
+    Author: Andrew Popa
+    */
+    bool IsFalling(int i) {
+        return y[i] < Config::screenHeight - r[i];
+    }
+
+    /*
+    Description: Get the number of cycles the meteorite is on the screen
+    Input: Position of the meteorite
+    Output: Number of cycles the meteorite is on the screen
+    Author: Andrew Popa
+    */
+    float AliveCycles(int i) {
+        return (Config::screenHeight - 2 * r[i]) / speed[i];
+    }
+
+    /*
+    Description: calculates the minimum cycles a meteorite can have before death
+    Input: Position of the meteorite
+    Output: Minimum number of cycles the meteorite can be on the screen
+    Author: Andrew Popa
+    */
+    float DeathMin(int i) {
+        return AliveCycles(i) * tuning.deathMin;
+    }
+
+    /*
+    Description: calculates the maximum cycles a meteorite can have before death
+    Input: Position of the meteorite
+    Output: Maximum number of cycles the meteorite can be on the screen
+    Author: Andrew Popa
+    */
+    float DeathMax(int i) {
+        return AliveCycles(i) * tuning.deathMax;
+    }
+
+    /*
+    Description: Swaps two meteorites' positions in the arrays
+    Input: Both positions
+    Output: N/A
+    Author: Andrew Popa
+    */
+    void Swap(int a, int b) {
+        float tempF;
+        int tempI;
+        tempF = x[a]; x[a] = x[b]; x[b] = tempF;
+        tempF = y[a]; y[a] = y[b]; y[b] = tempF;
+        tempF = speed[a]; speed[a] = speed[b]; speed[b] = tempF;
+        tempI = r[a]; r[a] = r[b]; r[b] = tempI;
+        tempI = meteorite[a]; meteorite[a] = meteorite[b]; meteorite[b] = tempI;
+        position[meteorite[a]] = a;
+        position[meteorite[b]] = b;
+    }
+
+    /*
+    Description: Puts a meteorite on screen by moving it to the end of the meteorites on screen
+    Input: Meteorite
+    Output: N/A
+    Author: Andrew Popa
+    */
+    void Activate(int m) {
+        Swap(position[m], activeCount);
+        activeCount++;
+    }
+
+    /*
+    Description: Takes a meteorite off the screen and puts it on the wheel
+    Input: Meteorite, tick it wakes on, true if it respawns when it wakes, false if it just starts falling
+    Output: N/A
+    Author: Andrew Popa
+    */
+    void Schedule(int m, unsigned long wake, bool bRespawnOnWake) {
+        if (position[m] < activeCount) {
+            activeCount--;
+            Swap(position[m], activeCount);
+        }
+        wakeTick[m] = wake;
+        bRespawn[m] = bRespawnOnWake;
+        int slot = wake & (SPAWN_WHEEL_SLOTS - 1);
+        wheelNext[m] = wheel[slot];
+        wheel[slot] = m;
+    }
+
+public:
+    /*
+    Description: Constructor that creates each meteorite with a random speed, size and position, and a random start
+    delay on the wheel. The arrays are taken from the game's arena
+    Input: Difficulty values, random number generator of the game, arena of the game
+    Output: N/A
+    Author: Andrew Popa
+    */
+    MeteoritePool (const GameTuning &_tuning, GameRandom &_random, Arena &arena) : tuning(_tuning), random(_random) {
+        gameSpeed = tuning.speedStart;
+        count = tuning.meteoriteCount;
+        //A preset's number of meteorites is a constant
+        if (Config::meteoriteCount > 0)
+            count = Config::meteoriteCount;
+        capacity = count;
+        activeCount = 0;
+        tick = 0;
+        x = arena.AllocateArray<float>(capacity);
+        y = arena.AllocateArray<float>(capacity);
+        speed = arena.AllocateArray<float>(capacity);
+        r = arena.AllocateArray<int>(capacity);
+        meteorite = arena.AllocateArray<int>(capacity);
+        moving = arena.AllocateArray<unsigned char>(capacity);
+        position = arena.AllocateArray<int>(capacity);
+        wheelNext = arena.AllocateArray<int>(capacity);
+        wakeTick = arena.AllocateArray<unsigned long>(capacity);
+        bRespawn = arena.AllocateArray<unsigned char>(capacity);
+        events = arena.AllocateArray<int>(capacity);
+        for (int s = 0; s < SPAWN_WHEEL_SLOTS; s++)
+            wheel[s] = -1;
+        for (int i = 0; i < count; i++) {
+            meteorite[i] = position[i] = i;
+            resetMeteorite(i);
+            //Ensures that the meteorites will spawn uniformly distributed on the screen
+            int AvgMeteoriteCycle = (Config::screenHeight - (Config::radiusMin + Config::radiusMax)) / speed[i] + (DeathMin(i) + DeathMax(i)) / 2;
+            //Creates the start delay for each meteorite that makes them uniformly distributed. It falls the tick after
+            //the delay is over
+            int startDelay = random.NextFloat() * AvgMeteoriteCycle;
+            if (startDelay == 0)
+                Activate(i);
+            else
+                Schedule(i, startDelay, false);
+        }
+    }
+
+    /*
+    Description: Returns the number of meteorites in the pool
+    Input: N/A
+    Output: Number of meteorites
+    Author: Andrew Popa
+    */
+    int Count() {
+        return count;
+    }
+
+    /*
+    Description: Returns the number of meteorites on screen, falling or just landed
+    Input: N/A
+    Output: Number of meteorites on screen
+    Author: Andrew Popa
+    */
+    int ActiveCount() {
+        return activeCount;
+    }
+
+    /*
+    Description: Sets the game speed that new meteorites get their speed from
+    Input: Game speed
+    Output: N/A
+    Author: Andrew Popa
+    */
+    void SetGameSpeed(float _gameSpeed) {
+        gameSpeed = _gameSpeed;
+    }
+
+    /*
+    Description: Paints every falling meteorite at its current position
+    Input: Dirty regions of the frame, where the area each meteorite is drawn over is added
+    Output: N/A, draws the meteorites
+    Author: Andrew Popa
+    */
+    void Draw(DirtyRegions &dirty) {
+        for (int i = 0; i < activeCount; i++) {
+            if (IsFalling(i))
+                DrawMeteoriteSprite(dirty, x[i], y[i], r[i]);
+        }
+    }
+
+    /*
+    Description: Copies the position and radius of every falling meteorite, for drawing on another thread
+    Input: Arrays the x and y coordinates and radii are written to, at least Count() long
+    Output: Number of meteorites copied
+    Author: Andrew Popa
+    */
+    int CopyFalling(float *pX, float *pY, int *pR) {
+        int copied = 0;
+        for (int i = 0; i < activeCount; i++)
+            if (IsFalling(i)) {
+                pX[copied] = x[i];
+                pY[copied] = y[i];
+                pR[copied++] = r[i];
+            }
+        return copied;
+    }
+
+    /*
+    Description: Runs one cycle for all meteorites. Falling meteorites are moved in one batch. Meteorites that reached
+    the ground are destroyed and put on the wheel with a respawn delay, and the meteorites on this tick's wheel slot
+    start or respawn. Those events are handled in meteorite order so the random numbers are drawn in the same order
+    no matter where meteorites are in the arrays
+    Input: Particle system the debris of the meteorites that hit the ground is thrown into, NULL for none
+    Output: Number of meteorites that were just destroyed
+    Author: Andrew Popa
+    */
+    int Update(ParticleSystem *pEffects = NULL) {
+        tick++;
+        for (int i = 0; i < activeCount; i++)
+            moving[i] = IsFalling(i);
+        AdvanceMeteorites(y, speed, moving, activeCount);
+
+        //Meteorites that were already on the ground, and the ones that wake this tick
+        int eventCount = 0;
+        for (int i = 0; i < activeCount; i++)
+            if (!moving[i])
+                events[eventCount++] = meteorite[i];
+        for (int *pLink = &wheel[tick & (SPAWN_WHEEL_SLOTS - 1)]; *pLink >= 0; ) {
+            int m = *pLink;
+            if (wakeTick[m] == tick) {
+                *pLink = wheelNext[m];
+                events[eventCount++] = m;
+            } else {
+                pLink = &wheelNext[m];
+            }
+        }
+        //Only a few events happen per tick, so insertion sort
+        for (int e = 1; e < eventCount; e++) {
+            int m = events[e], k = e;
+            for (; k > 0 && events[k - 1] > m; k--)
+                events[k] = events[k - 1];
+            events[k] = m;
+        }
+
+        int justDestroyed = 0;
+        for (int e = 0; e < eventCount; e++) {
+            int m = events[e], i = position[m];
+            if (i >= activeCount) {
+                //Respawn Event or the first start, it falls from the next tick on
+                if (bRespawn[m])
+                    resetMeteorite(i);
+                Activate(m);
+            }
+            else {
+                //If just destroyed, then generate a respawn delay. Without a delay it stays on the ground and is
+                //destroyed again next tick
+                int respawnDelay = (DeathMin(i) + random.NextFloat() * (DeathMax(i) - DeathMin(i))) / speed[i];
+                if (pEffects)
+                    pEffects->Debris(x[i], Config::screenHeight - 1, r[i]);
+                if (respawnDelay > 0)
+                    Schedule(m, tick + respawnDelay, true);
+                justDestroyed++;
+            }
+        }
+        return justDestroyed;
+    }
+
+    /*
+    Description: Checks if any meteorite on screen touches a circle
+    Input: Collision subsystem to check with, x, y and radius of the circle
+    Output: True if there is a collision, false otherwise
+    Author: Andrew Popa
+    */
+    bool Collides(CollisionSystem &collisions, float px, float py, float pr) {
+        return collisions.Check(px, py, pr, x, y, r, activeCount);
+    }
+
+    /*
+    Description: Measures how dangerous a spot is, used by the batch simulator's bot. Every falling meteorite that would
+    hit a circle at this x adds more danger the closer it is to the circle's height
+    Input: x, y and radius of the circle
+    Output: Danger, 0 if no falling meteorite is in line with the circle
+    Author: Andrew Popa
+    */
+    float Threat(float px, float py, float pr) {
+        float threat = 0;
+        for (int i = 0; i < activeCount; i++) {
+            float dx = px - x[i], dy = py - y[i];
+            if (IsFalling(i) && dx * dx < (pr + r[i]) * (pr + r[i]) && dy > -r[i])
+                threat += 1 / (dy + r[i] + 1);
+        }
+        return threat;
+    }
+};
+
+/*
+Description: Player class that dictates movement and collisions of the Player. It redraws the player when 
+needed and checks where the player has moved. 
+Private: touchDirection function that checks direction pressed
+Public: current x location, MovePlayer function, PlayerY location function, DrawPlayer function
+Author: Andrew Popa
+*/
+class Player {
+    /*
+    Description: From Game function, if the touch is not -1 (as given from Game if the screen is not touched), 
+    then find which direction pressed (left or right)
+    Input: x value of where touched
+    Output: 1, if right, -1 if left, 0 if none
+    Author: Andrew Popa
+    */
+    int touchDirection(int xTouch) {
+        if (xTouch >= 0)
+            //return 1 if right and -1 if left side touched
+            return xTouch > GameConfig::screenWidth / 2 ? 1 : -1;
+        //0 as default if no touch
+        return 0;
+    }
+    public:
+    int xCurrent;
+
+    /*
+    Description: Checks which side has been touched and then increments or decrements player on x axis, once per tick
+    Input: x value of where touched
+    Output: N/A, changes next x position of player
+    Author: Andrew Popa
+    */
+    void MovePlayer(int xTouch) {
+        int direction = touchDirection(xTouch);
+        //If statment also checks if the player reaches the boundary of the screen
+        if (xCurrent - GameConfig::playerRadius - 1 > 0 && direction == -1)
+            xCurrent-=2;
+        else if (xCurrent + GameConfig::playerRadius < GameConfig::screenWidth -2 && direction == 1)
+            xCurrent+=2;
+    }
+
+    /*
+    Description: Constructor creating the start x value to 160
+    Input: N/A
+    Output: N/A, initializes start x value to midway of the screen
+    Author: Andrew Popa
+    */
+    Player () {
+        //Spawns player on center of screen
+        xCurrent = 160;
+    }
+    
+    /*
+    Description: Returns the y value of the player
+    Input: N/A
+    Output: int of the y value of the player
+    Author: Andrew Popa
+    */
+    int PlayerY () {
+        return GameConfig::screenHeight - GameConfig::playerRadius - GameConfig::playerHeight;
+    }
+    
+    /*
+    Description: Draws all parts of the player
+    Input: dirty regions of the frame, where the area the player is drawn over is added
+    Output: N/A draws the player
+    Author: Andrew Popa
+    */
+    void DrawPlayer(DirtyRegions &dirty) {
+        DrawPlayerSprite(dirty, xCurrent, PlayerY());
+    }
+};
+
+#define PROFILE_BINS 80                 //Histogram bins, four per doubling of time starting at 1 microsecond
+#ifndef PROFILE_CSV
+#define PROFILE_CSV NULL                //File the profile of each game is written to, set when building with -DPROFILE_CSV='"profile.csv"'
+#endif
+#ifndef PROFILE_OVERLAY
+#define PROFILE_OVERLAY false           //Shows the frame time in the top left corner while playing, set when building with -DPROFILE_OVERLAY=true
+#endif
+
+//Parts of a game frame that are timed separately
+enum ProfilePhase { PHASE_INPUT, PHASE_UPDATE, PHASE_COLLISIONS, PHASE_BACKGROUND, PHASE_PLAYER, PHASE_METEORITES, PHASE_EFFECTS, PHASE_SUBMIT, PHASE_SLEEP, PHASE_COUNT };
+const char *phaseNames[PHASE_COUNT] = {"input", "update", "collisions", "background", "player", "meteorites", "effects", "submit", "sleep"};
+
+/*
+Description: Timing statistics of one phase or of whole frames: minimum, maximum, total and a histogram with bins
+that grow by a quarter of a doubling, so both microsecond and multi-millisecond times are resolved
+Author: Andrew Popa
+*/
+struct ProfileSeries {
+    double min, max, total;
+    unsigned long count;
+    unsigned long histogram[PROFILE_BINS];
+
+    /*
+    Description: Empties the series
+    Input: N/A
+    Output: N/A
+    Author: Andrew Popa
+    */
+    void Reset() {
+        min = 1e9;
+        max = total = 0;
+        count = 0;
+        for (int i = 0; i < PROFILE_BINS; i++)
+            histogram[i] = 0;
+    }
+
+    /*
+    Description: Adds a time to the series
+    Input: Time in seconds
+    Output: N/A
+    Author: Andrew Popa
+    */
+    void Add(double seconds) {
+        if (seconds < min) min = seconds;
+        if (seconds > max) max = seconds;
+        total += seconds;
+        count++;
+        histogram[Bin(seconds)]++;
+    }
+
+    /*
+    Description: Finds the histogram bin of a time, times below 1 microsecond go in the first bin and times past the
+    last bin in the last one
+    Input: Time in seconds
+    Output: Bin index
+    Author: Andrew Popa
+    */
+    static int Bin(double seconds) {
+        double microseconds = seconds * 1e6;
+        if (microseconds <= 1)
+            return 0;
+        int bin = (int)(log2(microseconds) * 4);
+        return bin < PROFILE_BINS ? bin : PROFILE_BINS - 1;
+    }
+
+    /*
+    Description: Returns the time where a bin ends
+    Input: Bin index
+    Output: Time in seconds
+    Author: Andrew Popa
+    */
+    static double BinEnd(int bin) {
+        return pow(2.0, (bin + 1) / 4.0) / 1e6;
+    }
+
+    /*
+    Description: Mean time of the series
+    Input: N/A
+    Output: Time in seconds, 0 if empty
+    Author: Andrew Popa
+    */
+    double Mean() {
+        return count ? total / count : 0;
+    }
+
+    /*
+    Description: Estimates a percentile from the histogram, as the end of the bin it falls in, never past the maximum
+    Input: Percentile from 0 to 100
+    Output: Time in seconds, 0 if empty
+    Author: Andrew Popa
+    */
+    double Percentile(double percent) {
+        unsigned long seen = 0;
+        for (int i = 0; i < PROFILE_BINS; i++) {
+            seen += histogram[i];
+            if (seen > 0 && seen >= count * percent / 100)
+                return BinEnd(i) < max ? BinEnd(i) : max;
+        }
+        return max;
+    }
+};
+
+/*
+Description: Frame profiler for the game loop. Each frame is split into phases with Mark, which times the phase
+that just ended with the measurement clock. A phase can be marked several times in a frame (once per tick) and
+its times are added up for the frame. Keeps the statistics of every phase and of whole frames for a game and
+can write them to a CSV file or show the frame time on screen. Also counts the meteorites on screen each frame
+Private: statistics of each phase, statistics of frames, time of each phase in the current frame, start times of the
+frame and of the current phase, meteorites on screen this frame, their total and maximum over the game
+Public: Reset function, BeginFrame function, Mark function, CountActive function, EndFrame function, ActiveMean function, WriteCsv
+function, DrawOverlay function
+Author: Andrew Popa
+*/
+class FrameProfiler {
+    ProfileSeries phases[PHASE_COUNT];
+    ProfileSeries frames;
+    double frameTimes[PHASE_COUNT];
+    double frameStart, phaseStart;
+    int frameActive, activeMax;
+    unsigned long activeTotal;
+public:
+    /*
+    Description: Constructor that starts with empty statistics
+    Input: N/A
+    Output: N/A
+    Author: Andrew Popa
+    */
+    FrameProfiler () {
+        Reset();
+    }
+
+    /*
+    Description: Empties all statistics, used at the start of each game
+    Input: N/A
+    Output: N/A
+    Author: Andrew Popa
+    */
+    void Reset() {
+        for (int i = 0; i < PHASE_COUNT; i++)
+            phases[i].Reset();
+        frames.Reset();
+        frameActive = activeMax = 0;
+        activeTotal = 0;
+        frameStart = phaseStart = MeasureTime();
+    }
+
+    /*
+    Description: Starts timing a frame and its first phase
+    Input: N/A
+    Output: N/A
+    Author: Andrew Popa
+    */
+    void BeginFrame() {
+        for (int i = 0; i < PHASE_COUNT; i++)
+            frameTimes[i] = 0;
+        frameStart = phaseStart = MeasureTime();
+    }
+
+    /*
+    Description: Ends a phase, adding the time since the previous phase ended to the phase's time this frame, and
+    starts the next one
+    Input: Phase that just ended
+    Output: N/A
+    Author: Andrew Popa
+    */
+    void Mark(ProfilePhase phase) {
+        double now = MeasureTime();
+        frameTimes[phase] += now - phaseStart;
+        phaseStart = now;
+    }
+
+    /*
+    Description: Sets the number of meteorites on screen this frame
+    Input: Number of meteorites on screen
+    Output: N/A
+    Author: Andrew Popa
+    */
+    void CountActive(int active) {
+        frameActive = active;
+    }
+
+    /*
+    Description: Ends a frame, adding the time of each phase, the time since BeginFrame and the meteorites on screen
+    to the statistics
+    Input: N/A
+    Output: N/A
+    Author: Andrew Popa
+    */
+    void EndFrame() {
+        for (int i = 0; i < PHASE_COUNT; i++)
+            phases[i].Add(frameTimes[i]);
+        activeTotal += frameActive;
+        if (frameActive > activeMax)
+            activeMax = frameActive;
+        frames.Add(MeasureTime() - frameStart);
+    }
+
+    /*
+    Description: Mean number of meteorites on screen per frame
+    Input: N/A
+    Output: Mean, 0 if no frames
+    Author: Andrew Popa
+    */
+    double ActiveMean() {
+        return frames.count ? (double)activeTotal / frames.count : 0;
+    }
+
+    /*
+    Description: Writes the statistics to a CSV file: one row per phase and for whole frames, then the frame histogram
+    Input: File name
+    Output: True if the file was written
+    Author: Andrew Popa
+    */
+    bool WriteCsv(const char *fileName) {
+        FILE *pFile = fopen(fileName, "w");
+        if (!pFile)
+            return false;
+        fprintf(pFile, "phase,count,min_ms,mean_ms,p99_ms,max_ms\n");
+        for (int i = 0; i <= PHASE_COUNT; i++) {
+            ProfileSeries &series = i < PHASE_COUNT ? phases[i] : frames;
+            fprintf(pFile, "%s,%lu,%.4f,%.4f,%.4f,%.4f\n", i < PHASE_COUNT ? phaseNames[i] : "frame", series.count,
+                series.count ? series.min * 1000 : 0, series.Mean() * 1000, series.Percentile(99) * 1000, series.max * 1000);
+        }
+        fprintf(pFile, "\nactive_meteorites_mean,active_meteorites_max\n%.2f,%d\n", ActiveMean(), activeMax);
+        fprintf(pFile, "\nframe_histogram_upto_ms,frames\n");
+        for (int i = 0; i < PROFILE_BINS; i++)
+            if (frames.histogram[i])
+                fprintf(pFile, "%.4f,%lu\n", ProfileSeries::BinEnd(i) * 1000, frames.histogram[i]);
+        fclose(pFile);
+        return true;
+    }
+
+    /*
+    Description: Writes the mean and 99th percentile frame time in the top left corner
+    Input: Dirty regions of the frame, where the area of the text is added
+    Output: N/A, records the text into the draw list
+    Author: Andrew Popa
+    */
+    void DrawOverlay(DirtyRegions &dirty) {
+        char text[32];
+        sprintf(text, "%.2f/%.2fms", frames.Mean() * 1000, frames.Percentile(99) * 1000);
+        Canvas.Text(LAYER_TEXT, WHITE, text, 0, 0);
+        dirty.Add(0, 0, strlen(text) * CHAR_WIDTH, CHAR_HEIGHT);
+    }
+
+#ifdef FEH_HEADLESS
+    /*
+    Description: Prints the statistics of each phase and of whole frames to the console
+    Input: N/A
+    Output: N/A
+    Author: Andrew Popa
+    */
+    void Print() {
+        for (int i = 0; i <= PHASE_COUNT; i++) {
+            ProfileSeries &series = i < PHASE_COUNT ? phases[i] : frames;
+            fprintf(stderr, "profile: %-10s min %.4f mean %.4f p99 %.4f max %.4f ms\n", i < PHASE_COUNT ? phaseNames[i] : "frame",
+                series.count ? series.min * 1000 : 0, series.Mean() * 1000, series.Percentile(99) * 1000, series.max * 1000);
+        }
+        fprintf(stderr, "profile: meteorites on screen mean %.2f max %d\n", ActiveMean(), activeMax);
+    }
+#endif
+};
+
+FrameProfiler Profiler;
+
+/*
+Description: Checks collisions between the player and all meteorites
+Input: Collision subsystem, pool of meteorites, object of class Player
+Output: True if there is a collision, false otherwise
+Author: Andrew Popa
+*/
+template <class Config>
+bool checkCollisions(CollisionSystem &collisions, MeteoritePool<Config> &meteorites, Player &player) {
+    return meteorites.Collides(collisions, player.xCurrent, player.PlayerY(), Config::playerRadius);
+}
+
+/*
+Description: State of one game without any drawing: its difficulty values, random numbers, meteorites, player and
+time played, compiled for a configuration. Game draws it, and the batch simulator runs many of them at once
+Public: tuning, random, meteorites, collisions, player, ticks, meteorites survived, game speed, effects, Constructor,
+Update function, Collided function, Duration function
+Author: Andrew Popa
+*/
+template <class Config>
+class GameSession {
+    //The player is drawn from the sprite cache and moved by Player, which use the default configuration
+    static_assert(Config::playerRadius == GameConfig::playerRadius && Config::playerHeight == GameConfig::playerHeight &&
+        Config::screenWidth == GameConfig::screenWidth && Config::screenHeight == GameConfig::screenHeight,
+        "the player only supports the default screen and player size");
+public:
+    GameTuning tuning;
+    GameRandom random;
+    MeteoritePool<Config> meteorites;
+    CollisionSystem collisions;
+    Player player;
+    unsigned long ticks;
+    int survived;
+    float speed;
+    ParticleSystem *pEffects;       //Effects of the game, NULL when nothing is drawn
+
+    /*
+    Description: Constructor that creates the meteorites of a game from its difficulty and seed
+    Input: Difficulty values, seed of the meteorites, arena the game's arrays are taken from (reset by the caller
+    once the game is over)
+    Output: N/A
+    Author: Andrew Popa
+    */
+    GameSession (const GameTuning &_tuning, unsigned int seed, Arena &arena) : tuning(_tuning), random(seed),
+        meteorites(tuning, random, arena), collisions(meteorites.Count(), arena) {
+        ticks = 0;
+        survived = 0;
+        speed = tuning.speedStart;
+        pEffects = NULL;
+    }
+
+    /*
+    Description: Runs one tick: moves the player and all the meteorites, adding the meteorites that just died to the
+    number survived, and speeds the game up every speedIncreaseSeconds of play
+    Input: x value of where touched, -1 if not touched
+    Output: N/A
+    Author: Andrew Popa
+    */
+    void Update(int xTouch) {
+        ticks++;
+        player.MovePlayer(xTouch);
+        survived += meteorites.Update(pEffects);
+        speed = tuning.speedStart + tuning.speedIncreaseAmount * ( ( Duration() / 1000 ) / Config::speedIncreaseSeconds );
+        meteorites.SetGameSpeed(speed);
+    }
+
+    /*
+    Description: Checks if the player was hit
+    Input: N/A
+    Output: True if there is a collision, false otherwise
+    Author: Andrew Popa
+    */
+    bool Collided() {
+        return checkCollisions(collisions, meteorites, player);
+    }
+
+    /*
+    Description: Time played, in ticks of SLEEP_MS, so it does not depend on how long drawing takes
+    Input: N/A
+    Output: Time played in MS
+    Author: Andrew Popa
+    */
+    unsigned long Duration() {
+        return ticks * SLEEP_MS;
+    }
+};
+
+#define REPLAY_FILE "last.rpl"         //Every game is recorded to this file, NULL to not record
+#define REPLAY_VERSION 1                //Changes whenever a change to the game would make old replays play differently
+#define REPLAY_BUFFER_SIZE 256          //Bytes a replay is buffered in before it is written or after it is read
+
+/*
+Replay file: the letters MDRP, REPLAY_VERSION, then varints (7 bits per byte, high bit set on all but the last byte)
+for the seed, map type and number of meteorites. The touch of every tick follows as runs: the change from the last
+run's value (touch x + 1, 0 for no touch) zigzag encoded so small changes either way stay small, then how many ticks
+it lasts. A run of 0 ticks ends the touches and is followed by the ticks played and meteorites survived, so playback
+can check that it got the same game. Holding a side or not touching costs a few bytes per run instead of per tick.
+*/
+
+/*
+Description: Writes a replay while a game is played, keeping only one small buffer and the current run in memory
+Private: file, buffer, bytes used, value and length of the current run, last value written, WriteByte function,
+WriteVarint function, WriteRun function
+Public: Constructor, Deconstructor, Record function, Finish function
+Author: Andrew Popa
+*/
+class ReplayWriter {
+    FILE *pFile;
+    unsigned char buffer[REPLAY_BUFFER_SIZE];
+    int used;
+    int runValue;
+    unsigned long runLength;
+    int lastValue;
+
+    /*
+    Description: Adds a byte to the buffer, writing the buffer to the file first if it is full
+    Input: byte to write
+    Output: N/A
+    Author: Andrew Popa
+    */
+    void WriteByte(unsigned char value) {
+        if (used == REPLAY_BUFFER_SIZE) {
+            fwrite(buffer, 1, used, pFile);
+            used = 0;
+        }
+        buffer[used++] = value;
+    }
+
+    /*
+    Description: Writes a number 7 bits at a time, with the top bit set on every byte but the last
+    Input: number to write
+    Output: N/A
+    Author: Andrew Popa
+    */
+    void WriteVarint(unsigned long value) {
+        while (value >= 0x80) {
+            WriteByte((unsigned char)(value | 0x80));
+            value >>= 7;
+        }
+        WriteByte((unsigned char)value);
+    }
+
+    /*
+    Description: Writes the current run as its zigzag encoded change from the last value and its length, if it has any ticks
+    Input: N/A
+    Output: N/A
+    Author: Andrew Popa
+    */
+    void WriteRun() {
+        if (runLength == 0)
+            return;
+        int delta = runValue - lastValue;
+        WriteVarint(delta >= 0 ? 2 * (unsigned long)delta : 2 * (unsigned long)(-delta) - 1);
+        WriteVarint(runLength);
+        lastValue = runValue;
+        runLength = 0;
+    }
+
+public:
+    /*
+    Description: Constructor that opens the replay file and writes the header. If the file can't be opened nothing is recorded
+    Input: file name, seed, map type, number of meteorites
+    Output: N/A
+    Author: Andrew Popa
+    */
+    ReplayWriter (const char *pFileName, unsigned int seed, int mapType, int meteoriteCount) {
+        used = 0;
+        runValue = 0;
+        runLength = 0;
+        lastValue = 0;
+        pFile = pFileName ? fopen(pFileName, "wb") : NULL;
+        if (!pFile)
+            return;
+        const char *pMagic = "MDRP";
+        for (int i = 0; i < 4; i++)
+            WriteByte(pMagic[i]);
+        WriteByte(REPLAY_VERSION);
+        WriteVarint(seed);
+        WriteVarint(mapType);
+        WriteVarint(meteoriteCount);
+    }
+
+    /*
+    Description: Deconstructor that writes what is left in the buffer and closes the file
+    Input: N/A
+    Output: N/A
+    Author: Andrew Popa
+    */
+    ~ReplayWriter () {
+        if (!pFile)
+            return;
+        fwrite(buffer, 1, used, pFile);
+        fclose(pFile);
+    }
+
+    /*
+    Description: Records the touch of one tick
+    Input: x value of where touched, -1 if not touched
+    Output: N/A
+    Author: Andrew Popa
+    */
+    void Record(int xTouch) {
+        if (!pFile)
+            return;
+        if (xTouch + 1 != runValue) {
+            WriteRun();
+            runValue = xTouch + 1;
+        }
+        runLength++;
+    }
+
+    /*
+    Description: Ends the touches and writes the result of the game
+    Input: ticks played, meteorites survived
+    Output: N/A
+    Author: Andrew Popa
+    */
+    void Finish(unsigned long ticks, int survived) {
+        if (!pFile)
+            return;
+        WriteRun();
+        WriteVarint(0);
+        WriteVarint(0);
+        WriteVarint(ticks);
+        WriteVarint(survived);
+    }
+};
+
+/*
+Description: Reads a replay back one tick at a time, with the same small buffer as the writer
+Private: file, buffer, bytes in it, read position, value and ticks left of the current run, ReadByte function,
+ReadVarint function
+Public: seed, map type, number of meteorites, recorded ticks and meteorites survived, whether the end was reached,
+Constructor, Deconstructor, IsOpen function, Next function
+Author: Andrew Popa
+*/
+class ReplayReader {
+    FILE *pFile;
+    unsigned char buffer[REPLAY_BUFFER_SIZE];
+    int size;
+    int position;
+    int runValue;
+    unsigned long runLeft;
+
+    /*
+    Description: Reads the next byte, refilling the buffer from the file when it is used up
+    Input: N/A
+    Output: The byte, -1 at the end of the file
+    Author: Andrew Popa
+    */
+    int ReadByte() {
+        if (position == size) {
+            size = fread(buffer, 1, REPLAY_BUFFER_SIZE, pFile);
+            position = 0;
+            if (size <= 0)
+                return -1;
+        }
+        return buffer[position++];
+    }
+
+    /*
+    Description: Reads a number written by WriteVarint
+    Input: pointer the number is written to
+    Output: False if the file ended or the number is too long
+    Author: Andrew Popa
+    */
+    bool ReadVarint(unsigned long *pValue) {
+        *pValue = 0;
+        for (int shift = 0; shift < 64; shift += 7) {
+            int value = ReadByte();
+            if (value < 0)
+                return false;
+            *pValue |= (unsigned long)(value & 0x7F) << shift;
+            if (!(value & 0x80))
+                return true;
+        }
+        return false;
+    }
+
+public:
+    unsigned int seed;
+    int mapType;
+    int meteoriteCount;
+    unsigned long ticks;
+    unsigned long survived;
+    bool bFinished;
+
+    /*
+    Description: Constructor that opens a replay and reads its header
+    Input: file name
+    Output: N/A, use IsOpen to see if it is a replay this version can play
+    Author: Andrew Popa
+    */
+    ReplayReader (const char *pFileName) {
+        size = 0;
+        position = 0;
+        runValue = 0;
+        runLeft = 0;
+        ticks = 0;
+        survived = 0;
+        bFinished = false;
+        pFile = fopen(pFileName, "rb");
+        if (!pFile)
+            return;
+        unsigned long header[3];
+        bool bValid = ReadByte() == 'M' && ReadByte() == 'D' && ReadByte() == 'R' && ReadByte() == 'P' &&
+            ReadByte() == REPLAY_VERSION && ReadVarint(&header[0]) && ReadVarint(&header[1]) && ReadVarint(&header[2]);
+        if (!bValid) {
+            fclose(pFile);
+            pFile = NULL;
+            return;
+        }
+        seed = header[0];
+        mapType = header[1];
+        meteoriteCount = header[2];
+    }
+
+    /*
+    Description: Deconstructor that closes the file
+    Input: N/A
+    Output: N/A
+    Author: Andrew Popa
+    */
+    ~ReplayReader () {
+        if (pFile)
+            fclose(pFile);
+    }
+
+    /*
+    Description: Checks if the replay was opened and is from this version of the game
+    Input: N/A
+    Output: True if it can be played
+    Author: Andrew Popa
+    */
+    bool IsOpen() {
+        return pFile != NULL;
+    }
+
+    /*
+    Description: Reads the touch of the next tick
+    Input: pointer the x value of the touch is written to, -1 for no touch
+    Output: False once the replay has no more ticks
+    Author: Andrew Popa
+    */
+    bool Next(int *pXTouch) {
+        if (!pFile || bFinished)
+            return false;
+        if (runLeft == 0) {
+            unsigned long delta, length;
+            if (!ReadVarint(&delta) || !ReadVarint(&length))
+                return false;
+            if (length == 0) {
+                ReadVarint(&ticks);
+                ReadVarint(&survived);
+                bFinished = true;
+                return false;
+            }
+            runValue += delta & 1 ? -(int)((delta + 1) / 2) : (int)(delta / 2);
+            runLeft = length;
+        }
+        runLeft--;
+        *pXTouch = runValue - 1;
+        return true;
+    }
+};
+
+#ifdef FEH_HEADLESS
+#define INPUT_CHANNEL_SIZE 64           //Touch changes that can wait for the simulation thread
+#define SNAPSHOT_FRESH 4                //Set on the shared snapshot index when it has not been read yet
+
+/*
+Description: Lock-free queue between exactly one producer thread and one consumer thread. Each side only writes its
+own counter, so no lock is needed
+Private: items, index of the next item to read and to write
+Public: Constructor, Push function, Pop function
+Author: Andrew Popa
+*/
+template <class T, int SIZE>
+class SpscQueue {
+    T items[SIZE];
+    std::atomic<unsigned int> head, tail;
+public:
+    /*
+    Description: Constructor that starts empty
+    Input: N/A
+    Output: N/A
+    Author: Andrew Popa
+    */
+    SpscQueue () : head(0), tail(0) {}
+
+    /*
+    Description: Adds an item, only called by the producer
+    Input: Item
+    Output: False if the queue is full
+    Author: Andrew Popa
+    */
+    bool Push(const T &item) {
+        unsigned int write = tail.load(std::memory_order_relaxed);
+        if (write - head.load(std::memory_order_acquire) == SIZE)
+            return false;
+        items[write % SIZE] = item;
+        tail.store(write + 1, std::memory_order_release);
+        return true;
+    }
+
+    /*
+    Description: Takes the oldest item, only called by the consumer
+    Input: Pointer the item is written to
+    Output: False if the queue is empty
+    Author: Andrew Popa
+    */
+    bool Pop(T *pItem) {
+        unsigned int read = head.load(std::memory_order_relaxed);
+        if (read == tail.load(std::memory_order_acquire))
+            return false;
+        *pItem = items[read % SIZE];
+        head.store(read + 1, std::memory_order_release);
+        return true;
+    }
+};
+
+/*
+Description: What the render thread needs to draw one tick of a game
+Author: Andrew Popa
+*/
+struct GameSnapshot {
+    int count;                  //Falling meteorites
+    float *x, *y;
+    int *r;
+    int playerX, playerY;
+    int active;                 //Meteorites on screen
+    int particleCount;          //Particles of the effects
+    float *particleX, *particleY;
+    unsigned int *particleColour;
+    unsigned char *particleSize;
+    unsigned long ticks;
+    int survived;
+    bool bOver;                 //The player was hit or the replay ended
+};
+
+/*
+Description: Triple buffered snapshots of the game. The simulation thread fills the back snapshot and swaps it with
+the shared one, the render thread swaps the shared one with its front snapshot when a new one was published. The
+swaps are single atomic exchanges, so neither thread ever waits and the render thread always gets the newest tick
+Private: snapshots, index of the shared one (with SNAPSHOT_FRESH if unread), back and front index
+Public: Constructor, Back function, Publish function, Latest function
+Author: Andrew Popa
+*/
+class SnapshotBuffer {
+    GameSnapshot snapshots[3];
+    std::atomic<int> shared;
+    int back, front;
+public:
+    /*
+    Description: Constructor that takes the snapshot arrays from the game's arena
+    Input: Number of meteorites, arena of the game, the particles always get PARTICLE_CAPACITY
+    Output: N/A
+    Author: Andrew Popa
+    */
+    SnapshotBuffer (int capacity, Arena &arena) : shared(1) {
+        back = 0;
+        front = 2;
+        for (int i = 0; i < 3; i++) {
+            snapshots[i].x = arena.AllocateArray<float>(capacity);
+            snapshots[i].y = arena.AllocateArray<float>(capacity);
+            snapshots[i].r = arena.AllocateArray<int>(capacity);
+            snapshots[i].count = 0;
+            snapshots[i].particleX = arena.AllocateArray<float>(PARTICLE_CAPACITY);
+            snapshots[i].particleY = arena.AllocateArray<float>(PARTICLE_CAPACITY);
+            snapshots[i].particleColour = arena.AllocateArray<unsigned int>(PARTICLE_CAPACITY);
+            snapshots[i].particleSize = arena.AllocateArray<unsigned char>(PARTICLE_CAPACITY);
+            snapshots[i].particleCount = 0;
+        }
+    }
+
+    /*
+    Description: Snapshot the simulation thread writes to
+    Input: N/A
+    Output: Back snapshot
+    Author: Andrew Popa
+    */
+    GameSnapshot &Back() {
+        return snapshots[back];
+    }
+
+    /*
+    Description: Publishes the back snapshot, called by the simulation thread after filling it
+    Input: N/A
+    Output: N/A
+    Author: Andrew Popa
+    */
+    void Publish() {
+        back = shared.exchange(back | SNAPSHOT_FRESH, std::memory_order_acq_rel) & ~SNAPSHOT_FRESH;
+    }
+
+    /*
+    Description: Returns the newest published snapshot, called by the render thread
+    Input: N/A
+    Output: Front snapshot, valid until the next call
+    Author: Andrew Popa
+    */
+    GameSnapshot &Latest() {
+        if (shared.load(std::memory_order_relaxed) & SNAPSHOT_FRESH)
+            front = shared.exchange(front, std::memory_order_acq_rel) & ~SNAPSHOT_FRESH;
+        return snapshots[front];
+    }
+};
+
+/*
+Description: Fills a snapshot with the state of a game
+Input: Snapshot, game
+Output: N/A
+Author: Andrew Popa
+*/
+template <class Config>
+void TakeSnapshot(GameSnapshot &snapshot, GameSession<Config> &session) {
+    snapshot.count = session.meteorites.CopyFalling(snapshot.x, snapshot.y, snapshot.r);
+    snapshot.playerX = session.player.xCurrent;
+    snapshot.playerY = session.player.PlayerY();
+    snapshot.active = session.meteorites.ActiveCount();
+    snapshot.particleCount = session.pEffects ? session.pEffects->Copy(snapshot.particleX, snapshot.particleY,
+        snapshot.particleColour, snapshot.particleSize) : 0;
+    snapshot.ticks = session.ticks;
+    snapshot.survived = session.survived;
+}
+
+/*
+Description: Plays a game with the simulation on its own thread, for the multi-core headless build. The simulation
+thread runs a tick every SLEEP_MS of real time: it takes the newest touch from the input queue, updates the game and
+its effects, checks collisions and publishes a snapshot with the particles. This thread polls the touch screen into the queue and draws the newest
+snapshot, so slow drawing never delays a collision check. Its Sleep waits for real while the game runs, so frames
+are counted and timed like any other loop's. When the touch script runs out it returns before polling again, since
+that poll ends the run and the simulation thread has to be joined first
+Input: Game, replay recording, replay to play or NULL, background, dirty regions of the frame
+Output: N/A, returns when the game is over
+Author: Andrew Popa
+*/
+template <class Config>
+void PlayThreaded(GameSession<Config> &session, ReplayWriter &recording, ReplayReader *pReplay, Asset &background, DirtyRegions &dirty) {
+    SpscQueue<int, INPUT_CHANNEL_SIZE> inputs;
+    SnapshotBuffer snapshots(session.meteorites.Count(), GameArena);
+    TakeSnapshot(snapshots.Back(), session);
+    snapshots.Back().bOver = false;
+    snapshots.Publish();
+    std::atomic<bool> bStop(false);
+    unsigned long lateTicks = 0;
+    double tickMax = 0;
+    SetRealSleep(true);
+
+    std::thread simulation([&]() {
+        typedef std::chrono::steady_clock Clock;
+        Clock::time_point next = Clock::now();
+        int xTouch = -1;
+        bool bOver = false;
+        while (!bOver && !bStop.load(std::memory_order_relaxed)) {
+            next += std::chrono::milliseconds(SLEEP_MS);
+            std::this_thread::sleep_until(next);
+            //If the thread fell too far behind, drop the extra time instead of trying to catch up with it
+            Clock::time_point start = Clock::now();
+            if (start - next > std::chrono::milliseconds(MAX_TICKS_PER_FRAME * SLEEP_MS)) {
+                next = start;
+                lateTicks++;
+            }
+            int newTouch;
+            while (inputs.Pop(&newTouch))
+                xTouch = newTouch;
+            //A replay gives the touch of every tick, and ends the game when it runs out
+            if (pReplay && !pReplay->Next(&xTouch)) {
+                bOver = true;
+            } else {
+                recording.Record(xTouch);
+                //Each tick is a frame of this thread, so it gets its own budget of particles
+                if (session.pEffects)
+                    session.pEffects->BeginFrame();
+                session.Update(xTouch);
+                bOver = session.Collided();
+                if (session.pEffects)
+                    session.pEffects->Update();
+            }
+            GameSnapshot &snapshot = snapshots.Back();
+            TakeSnapshot(snapshot, session);
+            snapshot.bOver = bOver;
+            snapshots.Publish();
+            double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+            if (seconds > tickMax)
+                tickMax = seconds;
+        }
+    });
+
+    int lastTouch = -1;
+    bool bOver = false;
+    while (!bOver) {
+        //The next poll would exit while the simulation thread still uses the game
+        if (!pReplay && LCD.TouchScriptFinished())
+            break;
+        Profiler.BeginFrame();
+        int xTouch, yTouch;
+        if (pReplay || !Input.IsDown(&xTouch, &yTouch))
+            xTouch = -1;
+        //Only changes are sent. If the queue is full the change is sent again next frame
+        if (xTouch != lastTouch && inputs.Push(xTouch))
+            lastTouch = xTouch;
+        Profiler.Mark(PHASE_INPUT);
+
+        GameSnapshot &snapshot = snapshots.Latest();
+        bOver = snapshot.bOver;
+        meteoriteSurvived = snapshot.survived;
+        gameDuration = snapshot.ticks * SLEEP_MS;
+        Profiler.CountActive(snapshot.active);
+        dirty.Restore(background);
+        Profiler.Mark(PHASE_BACKGROUND);
+        DrawPlayerSprite(dirty, snapshot.playerX, snapshot.playerY);
+        Profiler.Mark(PHASE_PLAYER);
+        for (int i = 0; i < snapshot.count; i++)
+            DrawMeteoriteSprite(dirty, snapshot.x[i], snapshot.y[i], snapshot.r[i]);
+        if (PROFILE_OVERLAY)
+            Profiler.DrawOverlay(dirty);
+        Profiler.Mark(PHASE_METEORITES);
+        PaintParticles(dirty, snapshot.particleX, snapshot.particleY, snapshot.particleColour, snapshot.particleSize,
+            snapshot.particleCount);
+        Profiler.Mark(PHASE_EFFECTS);
+        Canvas.Submit();
+        Profiler.Mark(PHASE_SUBMIT);
+        if (!bOver)
+            Sleep(SLEEP_MS);
+        Profiler.Mark(PHASE_SLEEP);
+        Profiler.EndFrame();
+    }
+    SetRealSleep(false);
+    bStop.store(true);
+    simulation.join();
+    fprintf(stderr, "simulation thread: %lu ticks, longest tick %.4f ms, fell behind %lu times\n", session.ticks,
+        tickMax * 1000, lateTicks);
+}
+#endif
+
+#define STATS_LOG_FILE "stats.log"      //Every game played is appended to this file
+#define STATS_INDEX_FILE "stats.idx"    //Bests and totals of the log, rebuilt from the log if missing or out of date
+#define STATS_OLD_LOG_FILE "stats.old"  //Where a log that can not be read is moved to
+#define STATS_VERSION 1
+#define STATS_MAPS 4
+#define STATS_DIFFICULTIES 3            //Easy, hard, and any other number of meteorites
+#define STATS_RECENT 3                  //Last games kept in the index for the stats screen
+#define STATS_READ_RECORDS 64           //Records read at a time when the index is rebuilt
+
+/*
+Description: One game in the stats log. The log is a StatsFileHeader followed by these, all little endian like the
+Proteus and x86 hosts
+Author: Andrew Popa
+*/
+struct StatsRecord {
+    unsigned char mapType;              //1 to STATS_MAPS
+    unsigned char difficulty;           //0 easy, 1 hard, 2 any other number of meteorites
+    unsigned short meteoriteCount;
+    unsigned int seed;
+    unsigned int durationMs;
+    unsigned int meteorites;            //Meteorites survived
+    unsigned int timestamp;             //Seconds since 1970 when the game ended, 0 if the clock is not set
+};
+
+/*
+Description: Start of the stats log and index files
+Author: Andrew Popa
+*/
+struct StatsFileHeader {
+    char magic[4];                      //"MDSL" for the log, "MDSI" for the index
+    unsigned int version;               //STATS_VERSION
+};
+
+/*
+Description: Bests and totals of the games of one map and difficulty
+Author: Andrew Popa
+*/
+struct StatsBest {
+    unsigned int games;
+    unsigned int bestDurationMs, bestMeteorites, bestSeed;
+    unsigned long long totalDurationMs, totalMeteorites;
+};
+
+/*
+Description: Index of the stats log. It is small and written whole after every game, and says how long the log was
+when it was written, so an index that does not match the log is noticed and rebuilt
+Author: Andrew Popa
+*/
+struct StatsIndex {
+    StatsFileHeader header;
+    unsigned int logBytes;              //Size of the log this index was made from
+    unsigned int games;                 //Games in the log
+    StatsBest bests[STATS_MAPS][STATS_DIFFICULTIES];
+    StatsRecord recent[STATS_RECENT];   //Last games, newest first
+};
+
+/*
+Description: Persistent stats of every game played. Each game is appended to the log with one small write, and the
+index of bests, totals and last games is updated and written next to it. At startup only the index is loaded, memory
+mapped in the headless build, so the stats screen never scans the log. The log is only read again when the index
+is missing or does not match it
+Private: index, whether it was loaded, time it took, whether it was rebuilt, Difficulty function, Apply function,
+LogSize function, ReadIndex function, WriteIndex function, StartLog function, Rebuild function
+Public: Constructor, Load function, Add function, Games function, Recent function, Best function
+Author: Andrew Popa
+*/
+class StatsHistory {
+    StatsIndex index;
+    bool bLoaded;
+    double loadSeconds;
+    bool bRebuilt;
+
+    /*
+    Description: Returns the difficulty slot of a number of meteorites
+    Input: Number of meteorites
+    Output: 0 easy, 1 hard, 2 other
+    Author: Andrew Popa
+    */
+    int Difficulty(int meteoriteCount) {
+        if (meteoriteCount == EasyConfig::meteoriteCount)
+            return 0;
+        if (meteoriteCount == HardConfig::meteoriteCount)
+            return 1;
+        return 2;
+    }
+
+    /*
+    Description: Adds a game to the bests, totals and last games of the index
+    Input: Record of the game
+    Output: False if the record is not a valid game
+    Author: Andrew Popa
+    */
+    bool Apply(const StatsRecord &record) {
+        if (record.mapType < 1 || record.mapType > STATS_MAPS || record.difficulty >= STATS_DIFFICULTIES)
+            return false;
+        StatsBest &best = index.bests[record.mapType - 1][record.difficulty];
+        if (best.games == 0 || record.durationMs > best.bestDurationMs) {
+            best.bestDurationMs = record.durationMs;
+            best.bestSeed = record.seed;
+        }
+        if (record.meteorites > best.bestMeteorites)
+            best.bestMeteorites = record.meteorites;
+        best.games++;
+        best.totalDurationMs += record.durationMs;
+        best.totalMeteorites += record.meteorites;
+        index.games++;
+        memmove(index.recent + 1, index.recent, (STATS_RECENT - 1) * sizeof(StatsRecord));
+        index.recent[0] = record;
+        return true;
+    }
+
+    /*
+    Description: Finds the size of the log without reading it
+    Input: N/A
+    Output: Size in bytes, 0 if there is no log
+    Author: Andrew Popa
+    */
+    unsigned int LogSize() {
+        FILE *pFile = fopen(STATS_LOG_FILE, "rb");
+        if (!pFile)
+            return 0;
+        fseek(pFile, 0, SEEK_END);
+        long size = ftell(pFile);
+        fclose(pFile);
+        return size > 0 ? size : 0;
+    }
+
+    /*
+    Description: Loads the index file into the index, memory mapped in the headless build and read with a single
+    fread otherwise
+    Input: N/A
+    Output: True if the file held an index of this version
+    Author: Andrew Popa
+    */
+    bool ReadIndex() {
+        bool bRead = false;
+#ifdef FEH_HEADLESS
+        int file = open(STATS_INDEX_FILE, O_RDONLY);
+        if (file < 0)
+            return false;
+        struct stat info;
+        if (fstat(file, &info) == 0 && info.st_size == sizeof(StatsIndex)) {
+            void *pMap = mmap(NULL, sizeof(StatsIndex), PROT_READ, MAP_PRIVATE, file, 0);
+            if (pMap != MAP_FAILED) {
+                memcpy(&index, pMap, sizeof(StatsIndex));
+                munmap(pMap, sizeof(StatsIndex));
+                bRead = true;
+            }
+        }
+        close(file);
+#else
+        FILE *pFile = fopen(STATS_INDEX_FILE, "rb");
+        if (!pFile)
+            return false;
+        bRead = fread(&index, sizeof(StatsIndex), 1, pFile) == 1;
+        fclose(pFile);
+#endif
+        return bRead && memcmp(index.header.magic, "MDSI", 4) == 0 && index.header.version == STATS_VERSION;
+    }
+
+    /*
+    Description: Writes the whole index to its file
+    Input: N/A
+    Output: N/A
+    Author: Andrew Popa
+    */
+    void WriteIndex() {
+        FILE *pFile = fopen(STATS_INDEX_FILE, "wb");
+        if (!pFile)
+            return;
+        fwrite(&index, sizeof(StatsIndex), 1, pFile);
+        fclose(pFile);
+    }
+
+    /*
+    Description: Starts a new log with only its header
+    Input: N/A
+    Output: Size of the new log, 0 if it could not be written
+    Author: Andrew Popa
+    */
+    unsigned int StartLog() {
+        FILE *pFile = fopen(STATS_LOG_FILE, "wb");
+        if (!pFile)
+            return 0;
+        StatsFileHeader header;
+        memcpy(header.magic, "MDSL", 4);
+        header.version = STATS_VERSION;
+        bool bWritten = fwrite(&header, sizeof(header), 1, pFile) == 1;
+        fclose(pFile);
+        return bWritten ? sizeof(header) : 0;
+    }
+
+    /*
+    Description: Empties the index and adds every game of the log to it again, then writes it. A log without a
+    header of this version is moved aside to STATS_OLD_LOG_FILE and a new one is started, so games added later are
+    not behind a header that makes every rebuild skip them
+    Input: Size of the log
+    Output: N/A
+    Author: Andrew Popa
+    */
+    void Rebuild(unsigned int logBytes) {
+        memset(&index, 0, sizeof(StatsIndex));
+        memcpy(index.header.magic, "MDSI", 4);
+        index.header.version = STATS_VERSION;
+        index.logBytes = logBytes;
+        FILE *pFile = fopen(STATS_LOG_FILE, "rb");
+        if (pFile) {
+            StatsFileHeader header;
+            bool bValid = fread(&header, sizeof(header), 1, pFile) == 1 && memcmp(header.magic, "MDSL", 4) == 0 &&
+                header.version == STATS_VERSION;
+            if (bValid) {
+                StatsRecord records[STATS_READ_RECORDS];
+                size_t count;
+                while ((count = fread(records, sizeof(StatsRecord), STATS_READ_RECORDS, pFile)) > 0)
+                    for (size_t i = 0; i < count; i++)
+                        Apply(records[i]);
+            }
+            fclose(pFile);
+            if (!bValid) {
+                remove(STATS_OLD_LOG_FILE);
+                rename(STATS_LOG_FILE, STATS_OLD_LOG_FILE);
+                //If it could not be moved, the new log replaces it
+                index.logBytes = StartLog();
+#ifdef FEH_HEADLESS
+                fprintf(stderr, "stats: %s has no header of version %d, moved to %s\n", STATS_LOG_FILE, STATS_VERSION,
+                    STATS_OLD_LOG_FILE);
+#endif
+            }
+        }
+        WriteIndex();
+        bRebuilt = true;
+    }
+
+public:
+    /*
+    Description: Constructor, the index is loaded by Load
+    Input: N/A
+    Output: N/A
+    Author: Andrew Popa
+    */
+    StatsHistory () {
+        memset(&index, 0, sizeof(StatsIndex));
+        bLoaded = false;
+        bRebuilt = false;
+        loadSeconds = 0;
+    }
+
+    /*
+    Description: Loads the index, or rebuilds it from the log if it is missing or was not written after the last
+    game in the log. The last game becomes the one the stats screen shows
+    Input: N/A
+    Output: N/A
+    Author: Andrew Popa
+    */
+    void Load() {
+        double start = MeasureTime();
+        unsigned int logBytes = LogSize();
+        if (!ReadIndex() || index.logBytes != logBytes)
+            Rebuild(logBytes);
+        bLoaded = true;
+        loadSeconds = MeasureTime() - start;
+        if (index.games > 0) {
+            gameDuration = index.recent[0].durationMs;
+            meteoriteSurvived = index.recent[0].meteorites;
+            gameSeed = index.recent[0].seed;
+        }
+#ifdef FEH_HEADLESS
+        fprintf(stderr, "stats: %u games, index %s in %.3f ms\n", index.games, bRebuilt ? "rebuilt from the log" : "loaded",
+            loadSeconds * 1000);
+#endif
+    }
+
+    /*
+    Description: Appends a game to the log and updates the index. The record goes out in one write, after the log's
+    header if the log is new. If the log ends in part of a record, it is padded to a whole record first so the ones
+    after it can still be read
+    Input: map type, number of meteorites, seed, duration in MS, meteorites survived
+    Output: N/A
+    Author: Andrew Popa
+    */
+    void Add(int mapType, int meteoriteCount, unsigned int seed, unsigned long durationMs, int meteorites) {
+        if (!bLoaded)
+            return;
+        StatsRecord record;
+        memset(&record, 0, sizeof(record));
+        record.mapType = mapType >= 1 && mapType <= STATS_MAPS ? mapType : STATS_MAPS;
+        record.difficulty = Difficulty(meteoriteCount);
+        record.meteoriteCount = meteoriteCount;
+        record.seed = seed;
+        record.durationMs = durationMs;
+        record.meteorites = meteorites;
+        record.timestamp = (unsigned int)time(NULL);
+
+        FILE *pFile = fopen(STATS_LOG_FILE, "ab");
+        if (!pFile)
+            return;
+        unsigned char buffer[sizeof(StatsFileHeader) + 2 * sizeof(StatsRecord)];
+        unsigned int used = 0;
+        if (index.logBytes == 0) {
+            StatsFileHeader header;
+            memcpy(header.magic, "MDSL", 4);
+            header.version = STATS_VERSION;
+            memcpy(buffer, &header, sizeof(header));
+            used = sizeof(header);
+        } else if (index.logBytes >= sizeof(StatsFileHeader)) {
+            unsigned int partial = (index.logBytes - sizeof(StatsFileHeader)) % sizeof(StatsRecord);
+            if (partial) {
+                used = sizeof(StatsRecord) - partial;
+                memset(buffer, 0, used);
+            }
+        }
+        memcpy(buffer + used, &record, sizeof(record));
+        used += sizeof(record);
+        bool bWritten = fwrite(buffer, 1, used, pFile) == used;
+        fclose(pFile);
+        if (!bWritten)
+            return;
+        index.logBytes += used;
+        Apply(record);
+        WriteIndex();
+    }
+
+    /*
+    Description: Number of games in the log
+    Input: N/A
+    Output: Games
+    Author: Andrew Popa
+    */
+    unsigned int Games() {
+        return index.games;
+    }
+
+    /*
+    Description: Returns one of the last games
+    Input: 0 for the newest
+    Output: The game, NULL if there are not that many
+    Author: Andrew Popa
+    */
+    const StatsRecord *Recent(int i) {
+        return i < STATS_RECENT && (unsigned int)i < index.games ? &index.recent[i] : NULL;
+    }
+
+    /*
+    Description: Returns the bests and totals of the map and difficulty of a game
+    Input: The game
+    Output: Its bests and totals
+    Author: Andrew Popa
+    */
+    const StatsBest &Best(const StatsRecord &record) {
+        return index.bests[record.mapType - 1][record.difficulty];
+    }
+};
+
+//Stats of every game played, kept between runs
+StatsHistory History;
+
+/*
+Description: Returns the file name of a map's background
+Input: map type
+Output: background image name
+Author: Andrew Popa
+*/
+char *MapBackground(int mapType) {
+    //Depending on the maptype passed, return the name of its background
+    if (mapType == 1) 
+        return "Space.png";
+    else if (mapType == 2) 
+        return "Lava.png";
+    else if (mapType == 3) 
+        return "Mines.png";
+    else    //mapType == 4, and the default map
+        return "Desert.png";
+}
+
+/*
+Description: Main game function, compiled for a configuration, that only executes after difficulty is selected. It
+calls all meteorite functions and player functions. The touches of each tick are recorded to REPLAY_FILE, or when a
+replay is given they are read from it instead of the touch screen
+Input: map type, number of meteorites (used by CustomConfig), seed of the meteorites, replay to play or NULL to play
+normally
+Output: N/A, just plays the game
+Author: Andrew Popa
+*/
+template <class Config>
+void PlayGame (int mapType, int meteoriteCount, unsigned int seed, ReplayReader *pReplay) 
 {
-    //Draw Background and title
-    LCD.Clear(BLACK);
-    FEHImage GalaxyBackground("GalaxyBackground.png");
-    GalaxyBackground.Draw(0, 0);
-    LCD.SetFontColor(GOLDENROD);
-    LCD.WriteAt("Choose Your Difficulty", 28, 75);
+    //The background was usually started loading while the difficulty was chosen
+    char *pBackgroundName = MapBackground(mapType);
+    Asset &background = Backgrounds.Take(pBackgroundName);
     
-    //Create Buttons objects and array
-    Button easy_btn(10,  100, 150, 70, CYAN,   CYAN,   "Easy", "EasyButton.png");
-    Button hard_btn(165, 100, 150, 70, YELLOW, YELLOW, "Hard", "HardButton.png");
-    Button back_btn(265, 10,  50,  30, WHITE,  WHITE,  "Back");
-    Button *buttons[] = {&easy_btn, &hard_btn,&back_btn, NULL};
-    DrawButtons(buttons);
-    int meteoriteCount = 0;
-    
-    while (true) {
-        Button *pButtonClicked = CheckButtonsClick(buttons, true);;
+    //Draw the meteorite and player sprites if this is the first game
+    Sprites.Build();
+    //create the game state: its random number generator, the meteorites and the player
+    gameSeed = seed;
+    meteoriteSurvived = 0;
+    GameSession<Config> session(ConfigTuning<Config>(meteoriteCount), seed, GameArena);
+    ReplayWriter recording(pReplay ? NULL : REPLAY_FILE, seed, mapType, meteoriteCount);
+    //Draw the whole background once, after that only the areas drawn over last frame are repainted.
+    //The areas are the meteorites, the player, the particles and the profiler text
+    DirtyRegions dirty(meteoriteCount + 2 + PARTICLE_CAPACITY, GameArena);
+    //The effects have their own random numbers, from a different seed so they do not follow the meteorites. With
+    //the simulation on its own thread they run on that thread and are drawn from its snapshots
+    ParticleSystem effects(seed ^ EFFECTS_SEED, GameArena);
+    session.pEffects = &effects;
+    LCD.Clear(BLACK);
+    background.Draw(0,0);
+    //The first frame is on screen once the whole background is
+    if (gameTapTime > 0) {
+        firstFrameSeconds = MeasureTime() - gameTapTime;
+        gameTapTime = 0;
+#ifdef FEH_HEADLESS
+        fprintf(stderr, "first frame: %.3f ms after the tap, background %s\n", firstFrameSeconds * 1000,
+            Backgrounds.IsPrefetched(pBackgroundName) ? "prefetched" : "loaded after the tap");
+#endif
+    }
+    gameDuration = 1;
+    if (!pReplay)
+        Input.Flush();
+    Profiler.Reset();
+    Quality.Reset();
+    DrawStats drawStart = Canvas.stats;
+
+    /*The game state moves forward in fixed ticks of SLEEP_MS, no matter how long drawing takes. Each frame adds the
+    time that passed to the accumulator, runs a tick for every SLEEP_MS in it, draws once and sleeps for the rest
+    of the tick. After the collision the loop keeps running for EXPLOSION_FRAMES ticks with the game frozen, so the
+    explosion is paced, profiled and governed like any other frame*/
+    unsigned long lastTime = TimeNowMSec();
+    unsigned long accumulator = SLEEP_MS;
+    bool bCollided = false, bExploded = false;
+    int explosionTicks = 0;
+#ifdef FEH_HEADLESS
+    if (bThreadedGame) {
+        PlayThreaded(session, recording, pReplay, background, dirty);
+        bCollided = true;
+        lastTime = TimeNowMSec();
+    }
+#endif
+    while (explosionTicks < EXPLOSION_FRAMES) {
+        Profiler.BeginFrame();
+        effects.BeginFrame();
+        double workStart = MeasureTime();
+        //Check if there is a touch, if there isn't assign xTouch to -1, so then there isnt a predefined touch when the loop executes again
+        int xTouch ,yTouch;
+        if (pReplay || !Input.IsDown(&xTouch, &yTouch))
+            xTouch = -1;
+        Profiler.Mark(PHASE_INPUT);
+
+        unsigned long frameStart = TimeNowMSec();
+        accumulator += frameStart - lastTime;
+        lastTime = frameStart;
+        //If drawing fell too far behind, drop the extra time instead of trying to catch up with it
+        if (accumulator > MAX_TICKS_PER_FRAME * SLEEP_MS)
+            accumulator = MAX_TICKS_PER_FRAME * SLEEP_MS;
+        //Explosion Animation: the player bursts into particles over the meteorites where they stopped, and the debris
+        //still in the air keeps falling with it
+        if (bCollided && !bExploded) {
+            effects.Explode(session.player.xCurrent, session.player.PlayerY());
+            bExploded = true;
+        }
+        while (accumulator >= SLEEP_MS && explosionTicks < EXPLOSION_FRAMES) {
+            accumulator -= SLEEP_MS;
+            //Once the game is over its state stays frozen and only the effects move
+            if (bExploded) {
+                explosionTicks++;
+                effects.Update();
+                Profiler.Mark(PHASE_EFFECTS);
+                continue;
+            }
+            //A replay gives the touch of every tick, and ends the game when it runs out
+            if (pReplay && !pReplay->Next(&xTouch)) {
+                bCollided = true;
+                break;
+            }
+            recording.Record(xTouch);
+            //Move the player and all the meteorites. The game duration is the time played in ticks, so the speed
+            //goes up at the same rate when drawing is slow
+            session.Update(xTouch);
+            meteoriteSurvived = session.survived;
+            gameDuration = session.Duration();
+            Profiler.Mark(PHASE_UPDATE);
+            //check if there are any collisions and if there are then stop, ending the game 
+            bCollided = session.Collided();
+            Profiler.Mark(PHASE_COLLISIONS);
+            effects.Update();
+            Profiler.Mark(PHASE_EFFECTS);
+            //The frame of the collision runs no more ticks, so it is drawn as the game ended
+            if (bCollided)
+                break;
+        }
+        Profiler.CountActive(session.meteorites.ActiveCount());
+
+        //When the quality governor is at its lowest level only every other frame is drawn
+        if (Quality.DrawFrame()) {
+            //Erase the previous frame's objects by repainting their areas from the background, then record the player
+            //unless it exploded
+            dirty.Restore(background);
+            Profiler.Mark(PHASE_BACKGROUND);
+            if (!bExploded)
+                session.player.DrawPlayer(dirty);
+            Profiler.Mark(PHASE_PLAYER);
+
+            /* In case a border for the game is desired
+            LCD.SetFontColor(__________);
+            LCD.DrawLine(0, 0, GameConfig::screenWidth - 1, 0);
+            LCD.DrawLine(GameConfig::screenWidth - 1, 0, GameConfig::screenWidth - 1, GameConfig::screenHeight - 1);
+            LCD.DrawLine(GameConfig::screenWidth - 1, GameConfig::screenHeight - 1, 0, GameConfig::screenHeight - 1);
+            LCD.DrawLine(0, GameConfig::screenHeight - 1, 0, 0); */
+
+            session.meteorites.Draw(dirty);
+            if (PROFILE_OVERLAY)
+                Profiler.DrawOverlay(dirty);
+            Profiler.Mark(PHASE_METEORITES);
+            effects.Draw(dirty);
+            Profiler.Mark(PHASE_EFFECTS);
+            //Everything recorded this frame is drawn in one pass
+            Canvas.Submit();
+            Profiler.Mark(PHASE_SUBMIT);
+        }
+
+        //The governor sees how long the frame took before sleeping, and drops or brings back detail
+        Quality.EndFrame(MeasureTime() - workStart);
+
+        //sleep for what is left of the tick, causing the end of the frame
+        unsigned long elapsed = accumulator + (TimeNowMSec() - frameStart);
+        if (explosionTicks < EXPLOSION_FRAMES && elapsed < SLEEP_MS)
+            Sleep((int)(SLEEP_MS - elapsed));
+        Profiler.Mark(PHASE_SLEEP);
+        Profiler.EndFrame();
+    }
+    recording.Finish(session.ticks, session.survived);
+    if (PROFILE_CSV)
+        Profiler.WriteCsv(PROFILE_CSV);
+    Quality.WriteLog(QUALITY_LOG_FILE, seed);
+#ifdef FEH_HEADLESS
+    fprintf(stderr, "collisions: %lu checks, %lu meteorites scanned, %lu pairs tested\n",
+        session.collisions.stats.checks, session.collisions.stats.scanned, session.collisions.stats.pairsTested);
+    Profiler.Print();
+    fprintf(stderr, "draw: %lu submits, %lu commands, %lu colour changes, %llu pixels, grown %lu times\n",
+        Canvas.stats.submits - drawStart.submits, Canvas.stats.commands - drawStart.commands,
+        Canvas.stats.colourChanges - drawStart.colourChanges, Canvas.stats.pixels - drawStart.pixels,
+        Canvas.stats.grows - drawStart.grows);
+    fprintf(stderr, "arena: %lu bytes used, %lu high-water, %lu capacity, grown %d times\n", GameArena.Used(),
+        GameArena.highWater > GameArena.Used() ? GameArena.highWater : GameArena.Used(), GameArena.Capacity(), GameArena.grows);
+#endif
+#ifdef FEH_HEADLESS
+    fprintf(stderr, "effects: %lu particles, %lu over the frame budget, %lu with the pool full, %d alive at most\n",
+        effects.stats.spawned, effects.stats.overBudget, effects.stats.poolFull, effects.stats.maxAlive);
+    fprintf(stderr, "quality: %d changes, ended at %s\n", Quality.changes, qualityNames[Quality.Level()]);
+#endif
+    //Nothing of the game is used after this, so all of its arrays are freed at once
+    GameArena.Reset();
+}
+
+/*
+Description: Plays a game with the preset compiled for its number of meteorites, or CustomConfig if no preset has it,
+and adds it to the stats history
+Input: map type, number of meteorites, seed of the meteorites, replay to play or NULL to play normally
+Output: N/A, just plays the game
+Author: Andrew Popa
+*/
+void Game (int mapType, int meteoriteCount, unsigned int seed, ReplayReader *pReplay) 
+{
+    if (meteoriteCount == EasyConfig::meteoriteCount)
+        PlayGame<EasyConfig>(mapType, meteoriteCount, seed, pReplay);
+    else if (meteoriteCount == HardConfig::meteoriteCount)
+        PlayGame<HardConfig>(mapType, meteoriteCount, seed, pReplay);
+    else if (meteoriteCount == StressConfig::meteoriteCount)
+        PlayGame<StressConfig>(mapType, meteoriteCount, seed, pReplay);
+    else
+        PlayGame<CustomConfig>(mapType, meteoriteCount, seed, pReplay);
+    //Replays are games that were already recorded
+    if (!pReplay)
+        History.Add(mapType, meteoriteCount, seed, gameDuration, meteoriteSurvived);
+}
+
+/*
+Description: Plays a replay in real time, drawn like a normal game
+Input: file name of the replay
+Output: True if the replay could be played
+Author: Andrew Popa
+*/
+bool PlayReplay(const char *pFileName) {
+    ReplayReader replay(pFileName);
+    if (!replay.IsOpen())
+        return false;
+    Game(replay.mapType, replay.meteoriteCount, replay.seed, &replay);
+    return true;
+}
+
+#define MAX_WIDGETS 24              //Widgets a screen can hold
+
+/*
+Description: Retained widget tree of a screen: its background and the widgets drawn over it, in drawing order. Paint
+draws the whole screen once when it is shown. After that Repaint only touches what changed: the areas the dirty
+widgets covered and now cover are restored from the background, and every widget in those areas is drawn again.
+When the areas can not be copied (no block copies, or a background that did not load) restoring redraws the
+whole background, so then every widget is drawn again
+Private: background, widgets, number of widgets, areas being repainted and their number, arena and dirty regions
+Public: Constructor, Add function, Paint function, Repaint function
+Author: Andrew Popa
+*/
+class WidgetTree {
+    Asset *pBackground;
+    Widget *pWidgets[MAX_WIDGETS];
+    int count;
+    Rect areas[2 * MAX_WIDGETS];
+    int areaCount;
+    Arena arena;
+    DirtyRegions dirty;
+
+    /*
+    Description: Checks if a widget touches any of the areas being repainted
+    Input: Widget
+    Output: True if it has to be drawn again
+    Author: Andrew Popa
+    */
+    bool Touches(Widget *pWidget) {
+        const Rect &a = pWidget->Area();
+        for (int i = 0; i < areaCount; i++) {
+            const Rect &b = areas[i];
+            if (a.x < b.x + b.width && b.x < a.x + a.width && a.y < b.y + b.height && b.y < a.y + a.height)
+                return true;
+        }
+        return false;
+    }
+
+    /*
+    Description: Adds an area to repaint
+    Input: Area
+    Output: N/A
+    Author: Andrew Popa
+    */
+    void AddArea(const Rect &rect) {
+        areas[areaCount++] = rect;
+        dirty.Add(rect.x, rect.y, rect.width, rect.height);
+    }
+public:
+    /*
+    Description: Constructor that starts with no widgets
+    Input: Background image, which covers the whole screen
+    Output: N/A
+    Author: Andrew Popa
+    */
+    WidgetTree (Asset *_pBackground) : arena(2 * MAX_WIDGETS * sizeof(Rect)), dirty(2 * MAX_WIDGETS, arena) {
+        pBackground = _pBackground;
+        count = 0;
+        areaCount = 0;
+    }
+
+    /*
+    Description: Adds a widget on top of the ones already added
+    Input: Widget, owned by the caller
+    Output: N/A
+    Author: Andrew Popa
+    */
+    void Add(Widget *pWidget) {
+        if (count < MAX_WIDGETS)
+            pWidgets[count++] = pWidget;
+    }
+
+    /*
+    Description: Draws the background and every widget
+    Input: N/A
+    Output: N/A
+    Author: Andrew Popa
+    */
+    void Paint() {
+        pBackground->Draw(0, 0);
+        for (int i = 0; i < count; i++) {
+            pWidgets[i]->Draw();
+            pWidgets[i]->Painted();
+        }
+        Canvas.Submit();
+    }
+
+    /*
+    Description: Repaints the widgets that changed since they were last painted
+    Input: N/A
+    Output: True if anything was drawn
+    Author: Andrew Popa
+    */
+    bool Repaint() {
+        areaCount = 0;
+        for (int i = 0; i < count; i++)
+            if (pWidgets[i]->IsDirty()) {
+                AddArea(pWidgets[i]->PaintedArea());
+                AddArea(pWidgets[i]->Area());
+            }
+        if (areaCount == 0)
+            return false;
+        //If the areas can not be copied the whole screen is redrawn, so every widget is drawn again
+        bool bAreas = dirty.CopiesAreas(*pBackground);
+        dirty.Restore(*pBackground);
+        for (int i = 0; i < count; i++) {
+            if (bAreas && !pWidgets[i]->IsDirty() && !Touches(pWidgets[i]))
+                continue;
+            pWidgets[i]->Draw();
+            pWidgets[i]->Painted();
+        }
+        Canvas.Submit();
+        return true;
+    }
+};
+
+#define SCENE_FRAME_MS 10           //Length of a menu frame, the loop sleeps for what is left of it
+
+//Screens of the game. SCENE_STAY is returned by a scene that keeps going
+enum SceneId { SCENE_STAY = -1, SCENE_MAIN_MENU, SCENE_MAP_SELECT, SCENE_DIFFICULTY, SCENE_GAME, SCENE_STATS, SCENE_CREDITS,
+    SCENE_INSTRUCTIONS, SCENE_QUIT };
+#define SCENE_COUNT SCENE_QUIT
+
+const char *sceneNames[SCENE_COUNT] = {"main menu", "map select", "difficulty", "game", "stats", "credits", "instructions"};
 
-        //If else statment to determine which difficulty to select based on return value of pButtonClicked
-        if (pButtonClicked == &easy_btn) {
-            meteoriteCount = METEORITES_EASY;
-            break;
+/*
+Description: Choices made on the menus that the game scene plays with
+Author: Andrew Popa
+*/
+struct GameSetup {
+    int mapType;                //1-4, see MapBackground
+    int meteoriteCount;
+    bool bReplay;               //Watch REPLAY_FILE instead of playing
+};
+
+GameSetup Setup = {0, 0, false};
+
+/*
+Description: Frame counters of a scene, to see how long its frames take without the sleep
+Author: Andrew Popa
+*/
+struct SceneStats {
+    unsigned long frames;
+    double workSeconds, workMax;
+};
+
+SceneStats sceneStats[SCENE_COUNT];
+
+/*
+Description: Returns the button a touch event clicked. A button is clicked when the finger is pressed and lifted
+inside of it
+Input: Array of pointers to Buttons, event
+Output: button that was clicked, NULL if none
+Author: Andrew Popa
+*/
+Button* ClickedButton(Button *pButtons[], const TouchEvent &event) {
+    //Only a release can finish a click
+    if (event.bPress)
+        return NULL;
+    for (int i = 0; pButtons[i] != NULL; i++)
+        //if the initial button clicked is in the same area  where the finger was lifted then return what button was clicked
+        if (pButtons[i]->Clicked(event.x, event.y) && pButtons[i]->Clicked(event.pressX, event.pressY))
+            return pButtons[i];
+    return NULL;
+}
+
+/*
+Description: Screen driven by the main loop. A scene is created the first time it is needed and kept, so its buttons
+and images are only made once. Nothing in a scene waits: the main loop gives it the touch events and a frame at a time
+and it returns the scene to switch to. A scene that is idle is not given frames, the main loop waits for a touch
+Public: Deconstructor, Prepare function, Enter function, OnEvent function, Update function, IsIdle function, Likely
+function
+Author: Andrew Popa
+*/
+class Scene {
+public:
+    virtual ~Scene () {}
+
+    /*
+    Description: Loads what the scene needs before it is shown. Called before every visit, and for the likely next
+    scene while the current one is idle, so it must be cheap when there is nothing new to load
+    Input: N/A
+    Output: N/A
+    Author: Andrew Popa
+    */
+    virtual void Prepare() {}
+
+    /*
+    Description: Draws the whole screen when the scene is switched to
+    Input: N/A
+    Output: N/A
+    Author: Andrew Popa
+    */
+    virtual void Enter() = 0;
+
+    /*
+    Description: Handles one touch event
+    Input: Event
+    Output: Scene to switch to, SCENE_STAY to keep going
+    Author: Andrew Popa
+    */
+    virtual int OnEvent(const TouchEvent &event) = 0;
+
+    /*
+    Description: Runs one frame of the scene after its events, for animations
+    Input: N/A
+    Output: Scene to switch to, SCENE_STAY to keep going
+    Author: Andrew Popa
+    */
+    virtual int Update() { return SCENE_STAY; }
+
+    /*
+    Description: Checks if the scene has nothing to do until a touch, so the main loop can wait for one instead of
+    running its frames. Scenes that animate or switch on their own in Update are idle only once they are done
+    Input: N/A
+    Output: True if Update has nothing to do
+    Author: Andrew Popa
+    */
+    virtual bool IsIdle() { return true; }
+
+    /*
+    Description: Returns the scene that most likely comes next, so it is prepared while this one waits for a touch
+    Input: N/A
+    Output: Next scene, SCENE_STAY if there is no likely one
+    Author: Andrew Popa
+    */
+    virtual int Likely() { return SCENE_STAY; }
+};
+
+/*
+Description: Start menu that branches out to all other screens
+Private: widget tree, title, buttons and array of them
+Public: Constructor, Enter function, OnEvent function, Likely function
+Author: Andrew Popa, Woojin Jeon
+*/
+class MainMenuScene : public Scene {
+    WidgetTree tree;
+    Label title;
+    Button start_btn, credits_btn, stats_btn, instructions_btn, quit_btn;
+    Button *buttons[6];
+public:
+    //Spacing for easier viewing*
+    MainMenuScene () : tree(Assets.Get("GalaxyBackground.png")),
+        title(65, 30, WHITE, "Meteorite Dash"),
+        start_btn(       10,  60,  150, 70, WHITE, GOLDENROD, "Start"),
+        credits_btn(     165, 60,  150, 70, WHITE, BLUE,      "Credits"),
+        stats_btn(       10,  160, 150, 70, WHITE, GREEN,     "Stats"),
+        instructions_btn(165, 160, 150, 70, WHITE, PURPLE,    "Instructions"),
+        quit_btn(        265, 10,  50,  30, RED,   RED,       "Quit") {
+        Button *all[] = {&start_btn, &credits_btn, &stats_btn, &instructions_btn, &quit_btn, NULL};
+        memcpy(buttons, all, sizeof(buttons));
+        tree.Add(&title);
+        for (int i = 0; buttons[i] != NULL; i++)
+            tree.Add(buttons[i]);
+    }
+
+    void Enter() {
+        tree.Paint();
+    }
+
+    int OnEvent(const TouchEvent &event) {
+        //Determine which secondary menu to open based on the button clicked
+        Button *pButtonClicked = ClickedButton(buttons, event);
+        if (pButtonClicked == &start_btn)
+            return SCENE_MAP_SELECT;
+        if (pButtonClicked == &credits_btn)
+            return SCENE_CREDITS;
+        if (pButtonClicked == &stats_btn)
+            return SCENE_STATS;
+        if (pButtonClicked == &instructions_btn)
+            return SCENE_INSTRUCTIONS;
+        if (pButtonClicked == &quit_btn)
+            return SCENE_QUIT;
+        return SCENE_STAY;
+    }
+
+    int Likely() { return SCENE_MAP_SELECT; }
+};
+
+/*
+Description: Selects which map for the background
+Private: widget tree, title, buttons and array of them
+Public: Constructor, Enter function, OnEvent function, Likely function
+Author: Andrew Popa
+*/
+class MapSelectScene : public Scene {
+    WidgetTree tree;
+    Label title;
+    Button space_btn, lava_btn, mines_btn, desert_btn, back_btn;
+    Button *buttons[6];
+public:
+    MapSelectScene () : tree(Assets.Get("GalaxyBackground.png")),
+        title(65, 30, GOLDENROD, "Choose Your Map"),
+        space_btn( 10,  60,  150, 70, DARKTURQUOISE, DARKTURQUOISE, "Space",  "SpaceButton.png"),
+        lava_btn(  165, 60,  150, 70, ORANGERED,     ORANGERED,     "Lava",   "LavaButton.png"),
+        mines_btn( 10,  160, 150, 70, LIGHTGRAY,     LIGHTGRAY,     "Mines",  "MinesButton.png"),
+        desert_btn(165, 160, 150, 70, TAN,           TAN,           "Desert", "DesertButton.png"),
+        back_btn(  265, 10,  50,  30, WHITE,         WHITE,         "Back") {
+        Button *all[] = {&space_btn, &lava_btn, &mines_btn, &desert_btn, &back_btn, NULL};
+        memcpy(buttons, all, sizeof(buttons));
+        tree.Add(&title);
+        for (int i = 0; buttons[i] != NULL; i++)
+            tree.Add(buttons[i]);
+    }
+
+    void Enter() {
+        tree.Paint();
+    }
+
+    int OnEvent(const TouchEvent &event) {
+        Button *pButtonClicked = ClickedButton(buttons, event);
+        if (pButtonClicked == &back_btn)
+            return SCENE_MAIN_MENU;
+        //The buttons are in map order, so the map type is the button's place in the array
+        for (int i = 0; i < 4; i++)
+            if (pButtonClicked == buttons[i]) {
+                Setup.mapType = i + 1;
+                Setup.bReplay = false;
+                return SCENE_DIFFICULTY;
+            }
+        return SCENE_STAY;
+    }
+
+    int Likely() { return SCENE_DIFFICULTY; }
+};
+
+/*
+Description: Selects which difficulty
+Private: widget tree, title, buttons and array of them
+Public: Constructor, Enter function, OnEvent function, Likely function
+Author: Andrew Popa
+*/
+class DifficultyScene : public Scene {
+    WidgetTree tree;
+    Label title;
+    Button easy_btn, hard_btn, back_btn;
+    Button *buttons[4];
+public:
+    DifficultyScene () : tree(Assets.Get("GalaxyBackground.png")),
+        title(28, 75, GOLDENROD, "Choose Your Difficulty"),
+        easy_btn(10,  100, 150, 70, CYAN,   CYAN,   "Easy", "EasyButton.png"),
+        hard_btn(165, 100, 150, 70, YELLOW, YELLOW, "Hard", "HardButton.png"),
+        back_btn(265, 10,  50,  30, WHITE,  WHITE,  "Back") {
+        Button *all[] = {&easy_btn, &hard_btn, &back_btn, NULL};
+        memcpy(buttons, all, sizeof(buttons));
+        tree.Add(&title);
+        for (int i = 0; buttons[i] != NULL; i++)
+            tree.Add(buttons[i]);
+    }
+
+    void Enter() {
+        tree.Paint();
+    }
+
+    int OnEvent(const TouchEvent &event) {
+        Button *pButtonClicked = ClickedButton(buttons, event);
+        if (pButtonClicked == &easy_btn || pButtonClicked == &hard_btn) {
+            if (pButtonClicked == &easy_btn)
+                Setup.meteoriteCount = EasyConfig::meteoriteCount;
+            else
+                Setup.meteoriteCount = HardConfig::meteoriteCount;
+            gameTapTime = MeasureTime();
+            return SCENE_GAME;
         }
-        else if (pButtonClicked == &hard_btn) {
-            meteoriteCount = METEORITES_HARD;
-            break;
+        if (pButtonClicked == &back_btn)
+            return SCENE_MAP_SELECT;
+        return SCENE_STAY;
+    }
+
+    //The map is chosen by now, so its background can be loaded while the player picks the difficulty
+    int Likely() { return SCENE_GAME; }
+};
+
+/*
+Description: Plays a game with the setup chosen on the menus, or watches the last replay. The game runs its own
+fixed-timestep loop with its own pacing and profiler, so the whole game is played when the scene is entered
+Public: Prepare function, Enter function, OnEvent function, Update function
+Author: Andrew Popa
+*/
+class GameScene : public Scene {
+public:
+    void Prepare() {
+        //Starts loading the background of the chosen map and draws the sprites, this is free the second time
+        if (!Setup.bReplay && Setup.mapType != 0)
+            Backgrounds.Start(MapBackground(Setup.mapType));
+        Sprites.Build();
+    }
+
+    void Enter() {
+        if (Setup.bReplay)
+            PlayReplay(REPLAY_FILE);
+        else
+            Game(Setup.mapType, Setup.meteoriteCount, NewGameSeed());
+    }
+
+    int OnEvent(const TouchEvent &) { return SCENE_STAY; }
+
+    //Once the game is over, the stats of it are shown
+    int Update() { return SCENE_STATS; }
+    bool IsIdle() { return false; }
+};
+
+/*
+Description: Shows the stats menu with the stats of the previous round, the best time and number of games of its
+map and difficulty, and the times of the last games, all from the stats history
+Private: widget tree, titles, values, times of the last games, buttons and array of them
+Public: Constructor, Enter function, OnEvent function
+Author: Andrew Popa
+*/
+class StatsScene : public Scene {
+    WidgetTree tree;
+    Label title, timeTitle, meteoritesTitle, seedTitle, bestTitle, gamesTitle, recentTitle;
+    Readout timeValue, meteoritesValue, seedValue, bestValue, gamesValue;
+    Readout *pRecent[STATS_RECENT];
+    Button back_btn, replay_btn;
+    Button *buttons[3];
+public:
+    //Same Structured back button, and a button that watches the last game again
+    StatsScene () : tree(Assets.Get("GalaxyBackground.png")),
+        title(          130, 30, GREEN, "Stats:"),
+        timeTitle(      10,  50, GREEN, "Time Survived: "),
+        meteoritesTitle(10,  70, GREEN, "Total Meteorites: "),
+        seedTitle(      10,  90, GREEN, "Seed: "),
+        bestTitle(      10,  110, GREEN, "Best Time: "),
+        gamesTitle(     10,  130, GREEN, "Games Played: "),
+        recentTitle(    170, 160, GREEN, "Last Games:"),
+        timeValue(      220, 50, WHITE),
+        meteoritesValue(220, 70, WHITE),
+        seedValue(      220, 90, WHITE),
+        bestValue(      220, 110, WHITE),
+        gamesValue(     220, 130, WHITE),
+        back_btn(265, 10, 50, 30, WHITE, WHITE, "Back"),
+        replay_btn(10, 160, 150, 70, WHITE, GREEN, "Replay") {
+        Button *all[] = {&back_btn, &replay_btn, NULL};
+        memcpy(buttons, all, sizeof(buttons));
+        Widget *widgets[] = {&title, &timeTitle, &meteoritesTitle, &seedTitle, &bestTitle, &gamesTitle, &recentTitle,
+            &timeValue, &meteoritesValue, &seedValue, &bestValue, &gamesValue, &back_btn, &replay_btn};
+        for (int i = 0; i < (int)(sizeof(widgets) / sizeof(widgets[0])); i++)
+            tree.Add(widgets[i]);
+        for (int i = 0; i < STATS_RECENT; i++) {
+            pRecent[i] = new Readout(170, 160 + CHAR_HEIGHT * (i + 1), WHITE);
+            tree.Add(pRecent[i]);
         }
-        else if (pButtonClicked == &back_btn) {
-            break;
+    }
+
+    ~StatsScene () {
+        for (int i = 0; i < STATS_RECENT; i++)
+            delete pRecent[i];
+    }
+
+    void Enter() {
+        char text[LABEL_LENGTH];
+        sprintf(text, "%.3f", (float)gameDuration/1000);
+        timeValue.SetText(text);
+        sprintf(text, "%d", meteoriteSurvived);
+        meteoritesValue.SetText(text);
+        //The seed is written in hexadecimal so it always fits next to its label
+        sprintf(text, "%08X", gameSeed);
+        seedValue.SetText(text);
+        //The bests are of the map and difficulty of the last game played
+        const StatsRecord *pLast = History.Recent(0);
+        if (pLast) {
+            const StatsBest &best = History.Best(*pLast);
+            sprintf(text, "%.3f", (float)best.bestDurationMs/1000);
+            bestValue.SetText(text);
+            sprintf(text, "%u", best.games);
+            gamesValue.SetText(text);
+        }
+        for (int i = 0; i < STATS_RECENT; i++) {
+            const StatsRecord *pRecord = History.Recent(i);
+            if (pRecord)
+                sprintf(text, "%.3f", (float)pRecord->durationMs/1000);
+            else
+                text[0] = '\0';
+            pRecent[i]->SetText(text);
+        }
+        tree.Paint();
+    }
+
+    int OnEvent(const TouchEvent &event) {
+        Button *pButtonClicked = ClickedButton(buttons, event);
+        if (pButtonClicked == &back_btn)
+            return SCENE_MAIN_MENU;
+        //If the replay can not be played, the game scene comes straight back here
+        if (pButtonClicked == &replay_btn) {
+            Setup.bReplay = true;
+            gameTapTime = MeasureTime();
+            return SCENE_GAME;
+        }
+        return SCENE_STAY;
+    }
+};
+
+#define CREDIT_LINES 6
+
+//Lines of the credits that move up
+const char *creditLines[CREDIT_LINES] = {"Meteorite Dash created by:", "Andrew Popa", "Woojin Jeon",
+    "Debugging contributors:", "Johanan Abraham", "Nicole Futoryansky"};
+
+/*
+Description: Shows the credits of the game in an animated way, moving the text up a pixel every frame. Only the
+lines that moved are repainted, and once they reach the top nothing is drawn at all
+Private: widget tree, title, lines, back button and array of it, text position, MoveLines function
+Public: Constructor, Deconstructor, Enter function, OnEvent function, Update function
+Author: Andrew Popa
+*/
+class CreditsScene : public Scene {
+    WidgetTree tree;
+    Label title;
+    Label *pLines[CREDIT_LINES];
+    Button back_btn;
+    Button *buttons[2];
+    int x, y;
+
+    /*
+    Description: Moves the lines to the text position
+    Input: N/A
+    Output: N/A
+    Author: Andrew Popa
+    */
+    void MoveLines() {
+        for (int i = 0; i < CREDIT_LINES; i++)
+            pLines[i]->Move(x, y + 15 * i);
+    }
+public:
+    CreditsScene () : tree(Assets.Get("GalaxyBackground.png")),
+        title(120, 30, BLUE, "Credits:"),
+        back_btn(265, 10, 50, 30, WHITE, WHITE, "Back") {
+        buttons[0] = &back_btn;
+        buttons[1] = NULL;
+        x = 10;
+        y = 150;
+        tree.Add(&title);
+        for (int i = 0; i < CREDIT_LINES; i++) {
+            pLines[i] = new Label(x, y + 15 * i, BLUE, creditLines[i]);
+            tree.Add(pLines[i]);
+        }
+        tree.Add(&back_btn);
+    }
+
+    ~CreditsScene () {
+        for (int i = 0; i < CREDIT_LINES; i++)
+            delete pLines[i];
+    }
+
+    //Starting values for text when it animates upwards
+    void Enter() {
+        y = 150;
+        MoveLines();
+        tree.Paint();
+        LCD.Update();
+    }
+
+    int OnEvent(const TouchEvent &event) {
+        return ClickedButton(buttons, event) ? SCENE_MAIN_MENU : SCENE_STAY;
+    }
+
+    int Update() {
+        //If the animation has not reached the top, move the text up a pixel
+        if (y > 50)
+            y -= 1;
+        MoveLines();
+        if (tree.Repaint())
+            LCD.Update();
+        return SCENE_STAY;
+    }
+
+    //Update paints the lines where they stop in the same frame they get there, after that nothing moves
+    bool IsIdle() { return y <= 50; }
+};
+
+#define INSTRUCTION_LINES 7
+
+//Lines of the instructions, the first is the title
+const char *instructionLines[INSTRUCTION_LINES] = {"Instructions:", "Move your player around",
+    "the map by touching each", "side of the screen based", "on direction. Make sure", "that you don't hit the",
+    "falling objects. Enjoy!"};
+
+/*
+Description: Shows the instructions for the game
+Private: widget tree, lines, back button and array of it
+Public: Constructor, Deconstructor, Enter function, OnEvent function
+Author: Andrew Popa
+*/
+class InstructionsScene : public Scene {
+    WidgetTree tree;
+    Label *pLines[INSTRUCTION_LINES];
+    Button back_btn;
+    Button *buttons[2];
+public:
+    InstructionsScene () : tree(Assets.Get("GalaxyBackground.png")),
+        back_btn(265, 10, 50, 30, WHITE, WHITE, "Back") {
+        buttons[0] = &back_btn;
+        buttons[1] = NULL;
+        int x = 10;
+        int y = 30;
+        for (int i = 0; i < INSTRUCTION_LINES; i++) {
+            //The title is further right than the rest
+            pLines[i] = new Label(i == 0 ? 50 : x, y + 20 * i, PURPLE, instructionLines[i]);
+            tree.Add(pLines[i]);
+        }
+        tree.Add(&back_btn);
+    }
+
+    ~InstructionsScene () {
+        for (int i = 0; i < INSTRUCTION_LINES; i++)
+            delete pLines[i];
+    }
+
+    void Enter() {
+        tree.Paint();
+    }
+
+    int OnEvent(const TouchEvent &event) {
+        return ClickedButton(buttons, event) ? SCENE_MAIN_MENU : SCENE_STAY;
+    }
+};
+
+Scene *scenes[SCENE_COUNT];
+
+/*
+Description: Returns a scene, creating it the first time, and prepares it
+Input: Scene
+Output: The prepared scene
+Author: Andrew Popa
+*/
+Scene *PrepareScene(int id) {
+    if (!scenes[id]) {
+        switch (id) {
+        case SCENE_MAIN_MENU:    scenes[id] = new MainMenuScene(); break;
+        case SCENE_MAP_SELECT:   scenes[id] = new MapSelectScene(); break;
+        case SCENE_DIFFICULTY:   scenes[id] = new DifficultyScene(); break;
+        case SCENE_GAME:         scenes[id] = new GameScene(); break;
+        case SCENE_STATS:        scenes[id] = new StatsScene(); break;
+        case SCENE_CREDITS:      scenes[id] = new CreditsScene(); break;
+        default:                 scenes[id] = new InstructionsScene(); break;
         }
     }
-    return meteoriteCount;
+    scenes[id]->Prepare();
+    return scenes[id];
 }
 
+#ifdef FEH_HEADLESS
 /*
-Description: Shows the credits of the game in an animated way
+Description: Prints the frame counters of every scene that was shown, registered with atexit
 Input: N/A
-Output: N/A, the animated credits printed
+Output: N/A
 Author: Andrew Popa
 */
-void ShowCredits() 
-{
-    //Creates just back button and loads it in same button array template as main menu
-    Button back_btn(265, 10, 50, 30, WHITE, WHITE, "Back");
-    Button *buttons[] = {&back_btn, NULL};
-    
-    FEHImage GalaxyBackground("GalaxyBackground.png");
-    
-    //Starting values for text when it animates upwards
-    int x = 10;
-    int y = 150;
-    /*While loop runs indefinitley and checks for a button clicked. This is loop permits the button to
-    be asynchronus because it checks once if the button is pressed, then animates for the next frame, then repeats.
-    If the button is pressed then it exits the whileloop/function*/
+void ReportScenes() {
+    for (int s = 0; s < SCENE_COUNT; s++)
+        if (sceneStats[s].frames)
+            fprintf(stderr, "scene %s: %lu frames, %.3f ms mean, %.3f ms max\n", sceneNames[s], sceneStats[s].frames,
+                sceneStats[s].workSeconds * 1000 / sceneStats[s].frames, sceneStats[s].workMax * 1000);
+}
+#endif
+
+/*
+Description: Main loop of the menus, which starts by loading the stats history. Every frame reads the touch events
+for the current scene, runs a frame of it, and sleeps for the rest of SCENE_FRAME_MS. The first idle frame of a scene prepares the scene likely to come next.
+After that an idle scene runs no frames: the loop waits for the next touch event with WaitForEvent instead.
+When a scene returns another scene, the new one is prepared and drawn, and the touches left over are thrown away
+Input: N/A
+Output: N/A, returns when quit is clicked
+Author: Andrew Popa
+*/
+void RunScenes() {
+    History.Load();
+    int current = SCENE_MAIN_MENU;
+    Scene *pScene = PrepareScene(current);
+    pScene->Enter();
+    Input.Flush();
+    bool bLikelyPrepared = false;
+
     while (true) {
-        /*Checks once for a button to be clicked asynchronously by using the false button, so in the CheckButtonsClick function
-        it won't run through the do while loop multiple times.*/
-        Button *pButtonClicked = CheckButtonsClick(buttons, false);;
-        if (pButtonClicked != NULL)
+        int next = SCENE_STAY;
+        TouchEvent event;
+        //Nothing changes on an idle screen until it is touched, so wait for that instead of running empty frames
+        bool bWaited = bLikelyPrepared && pScene->IsIdle() && Input.WaitForEvent(event);
+        unsigned long frameStart = TimeNowMSec();
+        double workStart = MeasureTime();
+        if (bWaited)
+            next = pScene->OnEvent(event);
+        while (next == SCENE_STAY && Input.NextEvent(event))
+            next = pScene->OnEvent(event);
+        if (next == SCENE_STAY)
+            next = pScene->Update();
+        if (next == SCENE_STAY && !bLikelyPrepared) {
+            if (pScene->Likely() != SCENE_STAY)
+                PrepareScene(pScene->Likely());
+            bLikelyPrepared = true;
+        }
+        double work = MeasureTime() - workStart;
+        sceneStats[current].frames++;
+        sceneStats[current].workSeconds += work;
+        if (work > sceneStats[current].workMax)
+            sceneStats[current].workMax = work;
+
+        if (next == SCENE_QUIT)
             break;
+        if (next == SCENE_STAY) {
+            unsigned long elapsed = TimeNowMSec() - frameStart;
+            if (elapsed < SCENE_FRAME_MS)
+                Sleep((int)(SCENE_FRAME_MS - elapsed));
+            continue;
+        }
+        current = next;
+        pScene = PrepareScene(current);
+        pScene->Enter();
+        Input.Flush();
+        bLikelyPrepared = false;
+    }
+}
+#ifdef FEH_HEADLESS
+#define BATCH_SESSIONS 1000         //Default number of games played for each set of difficulty values
+#define BATCH_MAX_SECONDS 300       //Games still going after this much play time are stopped
+#define BATCH_SWEEP_TICKS 150       //Ticks the sweeping input holds each side for
 
-        //Draw whole screen and the back button
-        LCD.Clear(BLACK);
-        GalaxyBackground.Draw(0,0);
-        LCD.SetFontColor(BLUE);
-        LCD.WriteAt("Credits:",                     120, 30);
-        LCD.WriteAt("Meteorite Dash created by:",   x,   y + 15 * 0);
-        LCD.WriteAt("Andrew Popa",                  x,   y + 15 * 1);
-        LCD.WriteAt("Woojin Jeon",                  x,   y + 15 * 2);
-        LCD.WriteAt("Debugging contributors:",      x,   y + 15 * 3);
-        LCD.WriteAt("Johanan Abraham",              x,   y + 15 * 4);
-        LCD.WriteAt("Nicole Futoryansky",           x,   y + 15 * 5);
-        DrawButtons(buttons);
-
-        //If the animation has not reached the top, subtract a pixel from next drawing
-        if(y > 50)
-            y -= 1;
+//How the player is moved in a batch game
+enum BatchInput { BATCH_BOT, BATCH_SWEEP };
 
-        LCD.Update();
-        //Sleep for 0.01 seconds and update again. This is like the framerate
-        Sleep(10);
+/*
+Description: Result of one batch game
+Author: Andrew Popa
+*/
+struct BatchResult {
+    unsigned long duration;     //Time survived in MS
+    int survived;               //Meteorites survived
+};
+
+/*
+Description: Bot that plays a batch game. It looks a few steps to each side and moves towards the spot with the least
+danger from falling meteorites, staying if that is where it already is
+Input: Game to play
+Output: x value of the touch, -1 for no touch
+Author: Andrew Popa
+*/
+template <class Config>
+int BotTouch(GameSession<Config> &session) {
+    Player &player = session.player;
+    int lookAhead = 4 * GameConfig::playerRadius;
+    int bestDirection = 0;
+    float bestThreat = session.meteorites.Threat(player.xCurrent, player.PlayerY(), GameConfig::playerRadius);
+    for (int direction = -1; direction <= 1; direction += 2) {
+        int x = player.xCurrent + direction * lookAhead;
+        if (x - GameConfig::playerRadius <= 0 || x + GameConfig::playerRadius >= GameConfig::screenWidth - 2)
+            continue;
+        //Moving only pays off if it is clearly safer than staying
+        float threat = session.meteorites.Threat(x, player.PlayerY(), GameConfig::playerRadius) * 1.25f;
+        if (threat < bestThreat) {
+            bestThreat = threat;
+            bestDirection = direction;
+        }
     }
+    if (bestDirection == 0)
+        return -1;
+    return bestDirection > 0 ? GameConfig::screenWidth - 1 : 0;
 }
 
 /*
-Description: Shows the stats menu with the stats of the previous round
-Input: N/A
-Output: N/A, prints stats to screen
+Description: Plays one game, compiled for a configuration, with no drawing until the player is hit or
+BATCH_MAX_SECONDS have been played
+Input: Difficulty values, seed, how the player is moved, arena of the thread running the game
+Output: Time and meteorites survived
 Author: Andrew Popa
 */
-void ShowStats() {
+template <class Config>
+BatchResult PlayBatchGame(const GameTuning &tuning, unsigned int seed, BatchInput input, Arena &arena) {
+    GameSession<Config> session(tuning, seed, arena);
+    while (session.Duration() < BATCH_MAX_SECONDS * 1000) {
+        int xTouch;
+        if (input == BATCH_BOT)
+            xTouch = BotTouch(session);
+        else
+            xTouch = (session.ticks / BATCH_SWEEP_TICKS) % 2 ? 0 : GameConfig::screenWidth - 1;
+        session.Update(xTouch);
+        if (session.Collided())
+            break;
+    }
+    BatchResult result = {session.Duration(), session.survived};
+    arena.Reset();
+    return result;
+}
 
-    LCD.Clear(BLACK);
-    FEHImage GalaxyBackground("GalaxyBackground.png");
-    GalaxyBackground.Draw(0, 0);
-    LCD.SetFontColor(GREEN);
-    LCD.WriteAt("Stats:",             130, 30);
-    LCD.WriteAt("Time Survived: ",    10,  50);
-    LCD.WriteAt("Total Meteorites: ", 10,  70);
-    LCD.SetFontColor(WHITE);
-    LCD.WriteAt((float)gameDuration/1000, 220, 50);
-    LCD.WriteAt(meteoriteSurvived, 220, 70);
-    
-    
-    //Same Structured back button
-    Button back_btn(265, 10, 50, 30, WHITE, WHITE, "Back");
-    Button *buttons[] = {&back_btn, NULL};
-    DrawButtons(buttons);
-    
-    Button *pButtonClicked = CheckButtonsClick(buttons, true);;
+/*
+Description: Plays one batch game with the preset compiled for its number of meteorites, or CustomConfig if no preset
+has it
+Input: Difficulty values, seed, how the player is moved, arena of the thread running the game
+Output: Time and meteorites survived
+Author: Andrew Popa
+*/
+BatchResult RunBatchGame(const GameTuning &tuning, unsigned int seed, BatchInput input, Arena &arena) {
+    if (tuning.meteoriteCount == EasyConfig::meteoriteCount)
+        return PlayBatchGame<EasyConfig>(tuning, seed, input, arena);
+    if (tuning.meteoriteCount == HardConfig::meteoriteCount)
+        return PlayBatchGame<HardConfig>(tuning, seed, input, arena);
+    if (tuning.meteoriteCount == StressConfig::meteoriteCount)
+        return PlayBatchGame<StressConfig>(tuning, seed, input, arena);
+    return PlayBatchGame<CustomConfig>(tuning, seed, input, arena);
 }
 
 /*
-Description: Shows the instructions for the game
-Input: N/A
-Output: N/A, just draws a screen
+Description: Work stealing thread pool. Tasks are numbers handed out round robin to a queue per thread. Each thread
+takes tasks from the back of its own queue, and once it is empty steals from the front of the others' queues, so
+threads that get quick tasks help the ones with slow tasks
+Input: Number of tasks, number of threads, function run with each task number and the number of the thread running it
+Output: N/A, returns once every task is done
 Author: Andrew Popa
 */
-void ShowInstructions()
-{   
-    //Display the instructions 
-    LCD.Clear(BLACK);
-    FEHImage GalaxyBackground("GalaxyBackground.png");
-    GalaxyBackground.Draw(0, 0);
-    LCD.SetFontColor(PURPLE);
-    int x = 10;
-    int y = 30;
-    LCD.WriteAt("Instructions:",            50, y+20*0);
-    LCD.WriteAt("Move your player around",  x,  y+20*1);
-    LCD.WriteAt("the map by touching each", x,  y+20*2);
-    LCD.WriteAt("side of the screen based", x,  y+20*3);
-    LCD.WriteAt("on direction. Make sure",  x,  y+20*4);
-    LCD.WriteAt("that you don't hit the",   x,  y+20*5);
-    LCD.WriteAt("falling objects. Enjoy!",  x,  y+20*6);
-
-    //Same back button structure as ShowStats
-    Button back_btn(265, 10, 50, 30, WHITE, WHITE, "Back");
-    Button *buttons[] = {&back_btn, NULL};
-    DrawButtons(buttons);
-
-    Button *pButtonClicked = CheckButtonsClick(buttons, true);
-}
\ No newline at end of file
+template <class Task>
+void RunWorkStealing(int taskCount, int threadCount, Task task) {
+    struct WorkQueue {
+        std::mutex lock;
+        std::deque<int> tasks;
+    };
+    std::vector<WorkQueue> queues(threadCount);
+    for (int i = 0; i < taskCount; i++)
+        queues[i % threadCount].tasks.push_back(i);
+
+    std::vector<std::thread> threads;
+    for (int t = 0; t < threadCount; t++)
+        threads.push_back(std::thread([&queues, &task, t, threadCount]() {
+            while (true) {
+                int next = -1;
+                //Own queue first, then every other queue starting with the next thread's
+                for (int k = 0; k < threadCount && next < 0; k++) {
+                    WorkQueue &queue = queues[(t + k) % threadCount];
+                    std::lock_guard<std::mutex> guard(queue.lock);
+                    if (queue.tasks.empty())
+                        continue;
+                    if (k == 0) {
+                        next = queue.tasks.back();
+                        queue.tasks.pop_back();
+                    } else {
+                        next = queue.tasks.front();
+                        queue.tasks.pop_front();
+                    }
+                }
+                //Tasks never add tasks, so once every queue is empty the work is done
+                if (next < 0)
+                    return;
+                task(next, t);
+            }
+        }));
+    for (size_t t = 0; t < threads.size(); t++)
+        threads[t].join();
+}
+
+/*
+Description: Returns a percentile of sorted values
+Input: Sorted values, percentile from 0 to 100
+Output: The value at the percentile
+Author: Andrew Popa
+*/
+double SortedPercentile(const std::vector<double> &values, double percent) {
+    size_t index = (size_t)(percent / 100 * (values.size() - 1) + 0.5);
+    return values[index];
+}
+
+/*
+Description: Prints the mean, 10th, 50th and 90th percentile and maximum of values
+Input: Label, values (sorted by the function)
+Output: N/A, prints to the console
+Author: Andrew Popa
+*/
+void PrintDistribution(const char *label, std::vector<double> &values) {
+    std::sort(values.begin(), values.end());
+    double total = 0;
+    for (size_t i = 0; i < values.size(); i++)
+        total += values[i];
+    printf("  %-18s mean %8.2f  p10 %8.2f  p50 %8.2f  p90 %8.2f  max %8.2f\n", label, total / values.size(),
+        SortedPercentile(values, 10), SortedPercentile(values, 50), SortedPercentile(values, 90), values.back());
+}
+
+/*
+Description: Plays a replay with no drawing, as fast as the CPU allows, compiled for a configuration
+Input: Replay, ticks played and meteorites survived to fill in
+Output: N/A
+Author: Andrew Popa
+*/
+template <class Config>
+void ReplayFast(ReplayReader &replay, unsigned long *pTicks, int *pSurvived) {
+    GameSession<Config> session(ConfigTuning<Config>(replay.meteoriteCount), replay.seed, GameArena);
+    int xTouch;
+    while (replay.Next(&xTouch)) {
+        session.Update(xTouch);
+        if (session.Collided())
+            break;
+    }
+    *pTicks = session.ticks;
+    *pSurvived = session.survived;
+    GameArena.Reset();
+}
+
+/*
+Description: Replay mode of the headless build. Plays a replay as fast as the CPU allows with no drawing, or with
+--realtime drawn like a normal game, and checks it ends the same way it was recorded
+Input: Number of arguments and the arguments after --replay: file name, then optionally --realtime
+Output: 0 if the replay matches its recording, 1 otherwise
+Author: Andrew Popa
+*/
+int RunReplay(int argc, char *argv[]) {
+    if (argc < 1) {
+        fprintf(stderr, "replay: missing file name\n");
+        return 1;
+    }
+    ReplayReader replay(argv[0]);
+    if (!replay.IsOpen()) {
+        fprintf(stderr, "replay: %s is not a version %d replay\n", argv[0], REPLAY_VERSION);
+        return 1;
+    }
+    unsigned long ticks;
+    int survived;
+    double start = TimeNowReal();
+    if (argc > 1 && strcmp(argv[1], "--realtime") == 0) {
+        Game(replay.mapType, replay.meteoriteCount, replay.seed, &replay);
+        ticks = gameDuration / SLEEP_MS;
+        survived = meteoriteSurvived;
+    } else if (replay.meteoriteCount == EasyConfig::meteoriteCount) {
+        ReplayFast<EasyConfig>(replay, &ticks, &survived);
+    } else if (replay.meteoriteCount == HardConfig::meteoriteCount) {
+        ReplayFast<HardConfig>(replay, &ticks, &survived);
+    } else if (replay.meteoriteCount == StressConfig::meteoriteCount) {
+        ReplayFast<StressConfig>(replay, &ticks, &survived);
+    } else {
+        ReplayFast<CustomConfig>(replay, &ticks, &survived);
+    }
+    double seconds = TimeNowReal() - start;
+    printf("replay: seed %08X, map %d, %d meteorites: %lu ticks, %d meteorites survived in %.3f ms (%.0f ticks/s)\n",
+        replay.seed, replay.mapType, replay.meteoriteCount, ticks, survived, seconds * 1000, ticks / seconds);
+    //Read to the end of the touches if the game ended first, to get what was recorded
+    int xTouch;
+    while (replay.Next(&xTouch));
+    if (!replay.bFinished) {
+        printf("replay: recording has no result, the game may not have finished\n");
+        return 1;
+    }
+    bool bMatch = replay.ticks == ticks && (int)replay.survived == survived;
+    printf("replay: recorded %lu ticks, %lu meteorites survived: %s\n", replay.ticks, replay.survived,
+        bMatch ? "match" : "MISMATCH");
+    return bMatch ? 0 : 1;
+}
+
+/*
+Description: Batch mode of the headless build. Plays thousands of games with no drawing, spread over all cores, for
+each set of difficulty values and prints the distribution of time and meteorites survived for each set. The same
+seeds are used for every set so the sets are compared on the same meteorites.
+Arguments: --sessions N (games per set), --threads N, --input bot|sweep, --seed N (first seed), --params file, where
+each line of the file is a set: meteorites speedStart speedIncrease deathMin deathMax speedMin speedMax, --preset
+menu|stress (the counts tried without a params file: easy and hard, or the stress preset's)
+Input: Number of arguments and the arguments after --batch
+Output: 0 if it ran, 1 if the arguments are wrong
+Author: Andrew Popa
+*/
+int RunBatch(int argc, char *argv[]) {
+    int sessions = BATCH_SESSIONS;
+    int threadCount = std::thread::hardware_concurrency() > 0 ? std::thread::hardware_concurrency() : 1;
+    BatchInput input = BATCH_BOT;
+    unsigned int firstSeed = 1;
+    const char *pParamsFile = NULL;
+    bool bStress = false;
+    for (int i = 0; i + 1 < argc; i += 2) {
+        if (strcmp(argv[i], "--sessions") == 0) sessions = atoi(argv[i + 1]);
+        else if (strcmp(argv[i], "--threads") == 0) threadCount = atoi(argv[i + 1]);
+        else if (strcmp(argv[i], "--seed") == 0) firstSeed = strtoul(argv[i + 1], NULL, 10);
+        else if (strcmp(argv[i], "--params") == 0) pParamsFile = argv[i + 1];
+        else if (strcmp(argv[i], "--input") == 0) input = strcmp(argv[i + 1], "sweep") == 0 ? BATCH_SWEEP : BATCH_BOT;
+        else if (strcmp(argv[i], "--preset") == 0) bStress = strcmp(argv[i + 1], "stress") == 0;
+        else {
+            fprintf(stderr, "batch: unknown argument %s\n", argv[i]);
+            return 1;
+        }
+    }
+    if (sessions <= 0 || threadCount <= 0) {
+        fprintf(stderr, "batch: --sessions and --threads must be positive\n");
+        return 1;
+    }
+
+    //Read the sets of difficulty values, or try the preset counts with a few speed increases
+    std::vector<GameTuning> sets;
+    if (pParamsFile) {
+        FILE *pFile = fopen(pParamsFile, "r");
+        if (!pFile) {
+            fprintf(stderr, "batch: could not open %s\n", pParamsFile);
+            return 1;
+        }
+        char line[256];
+        GameTuning tuning;
+        while (fgets(line, sizeof(line), pFile))
+            if (sscanf(line, "%d %f %f %f %f %f %f", &tuning.meteoriteCount, &tuning.speedStart, &tuning.speedIncreaseAmount,
+                    &tuning.deathMin, &tuning.deathMax, &tuning.speedMin, &tuning.speedMax) == 7 && tuning.meteoriteCount > 0)
+                sets.push_back(tuning);
+        fclose(pFile);
+    } else {
+        int counts[] = {EasyConfig::meteoriteCount, HardConfig::meteoriteCount};
+        int countSets = 2;
+        if (bStress) {
+            counts[0] = StressConfig::meteoriteCount;
+            countSets = 1;
+        }
+        float increases[] = {GameConfig::speedIncreaseAmount * 0.5f, GameConfig::speedIncreaseAmount,
+            GameConfig::speedIncreaseAmount * 2};
+        for (int c = 0; c < countSets; c++)
+            for (int i = 0; i < 3; i++) {
+                GameTuning tuning = ConfigTuning<CustomConfig>(counts[c]);
+                tuning.speedIncreaseAmount = increases[i];
+                sets.push_back(tuning);
+            }
+    }
+
+    std::vector<BatchResult> results(sets.size() * sessions);
+    double start = TimeNowReal();
+    //Each thread plays its games in its own arena
+    Arena *arenas = new Arena[threadCount];
+    RunWorkStealing((int)results.size(), threadCount, [&](int task, int thread) {
+        results[task] = RunBatchGame(sets[task / sessions], firstSeed + task % sessions, input, arenas[thread]);
+    });
+    double seconds = TimeNowReal() - start;
+    unsigned long arenaHighWater = 0;
+    for (int t = 0; t < threadCount; t++)
+        if (arenas[t].highWater > arenaHighWater)
+            arenaHighWater = arenas[t].highWater;
+    delete[] arenas;
+
+    unsigned long long totalTicks = 0;
+    for (size_t s = 0; s < sets.size(); s++) {
+        const GameTuning &t = sets[s];
+        printf("set %d: meteorites %d, speed start %.4f, increase %.4f, death %.2f-%.2f, meteorite speed %.2f-%.2f\n",
+            (int)s + 1, t.meteoriteCount, t.speedStart, t.speedIncreaseAmount, t.deathMin, t.deathMax, t.speedMin, t.speedMax);
+        std::vector<double> durations, survived;
+        for (int i = 0; i < sessions; i++) {
+            const BatchResult &result = results[s * sessions + i];
+            durations.push_back(result.duration / 1000.0);
+            survived.push_back(result.survived);
+            totalTicks += result.duration / SLEEP_MS;
+        }
+        PrintDistribution("time survived (s)", durations);
+        PrintDistribution("meteorites", survived);
+    }
+    printf("%d games, %llu ticks in %.3f s on %d threads: %.0f games/s, %.0f ticks/s\n", (int)results.size(), totalTicks,
+        seconds, threadCount, results.size() / seconds, totalTicks / seconds);
+    printf("arena high-water %lu bytes per game\n", arenaHighWater);
+    return 0;
+}
+#endif
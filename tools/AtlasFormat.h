@@ -0,0 +1,40 @@
+#ifndef ATLASFORMAT_H
+#define ATLASFORMAT_H
+
+/*
+Texture atlas file written by tools/AtlasPack.cpp and read by the game's AssetCache. All values are little endian,
+like the Proteus and x86 hosts, so the file is used without conversion:
+    AtlasHeader
+    AtlasEntry, header.count times
+    padding up to header.pixelOffset (a multiple of 16)
+    header.width * header.height RGB565 pixels, row by row
+Transparent pixels of masked entries are ATLAS_KEY.
+*/
+
+#define ATLAS_VERSION 1
+#define ATLAS_NAME_LENGTH 32        //Longest image file name stored, with its terminator
+#define ATLAS_KEY 0xF81F            //Pixels of this value in masked entries are not drawn (magenta)
+
+/*
+Description: Start of an atlas file
+Author: Andrew Popa
+*/
+struct AtlasHeader {
+    char magic[4];                  //"MDAT"
+    unsigned int version;           //ATLAS_VERSION
+    unsigned int width, height;     //Size of the atlas in pixels
+    unsigned int count;             //Number of entries
+    unsigned int pixelOffset;       //Where the pixels start in the file
+};
+
+/*
+Description: One image packed in the atlas
+Author: Andrew Popa
+*/
+struct AtlasEntry {
+    char name[ATLAS_NAME_LENGTH];           //File name of the image it was packed from
+    unsigned short x, y, width, height;     //Area of the atlas it occupies
+    unsigned int bMasked;                   //1 if some pixels are transparent
+};
+
+#endif
@@ -0,0 +1,162 @@
+#include "FEHImages.h"
+#include "AtlasFormat.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+Atlas packer. Decodes PNG images with the headless FEHImage and packs them into one RGB565 atlas file that the game
+loads instead of decoding the PNGs. Build and run it from the repository folder:
+    g++ -O2 -Iheadless tools/AtlasPack.cpp headless/FEHHeadless.cpp -lz -o atlas-pack
+    ./atlas-pack assets.atlas *.png
+*/
+
+#define ATLAS_WIDTH 960             //Width of the atlas (three backgrounds), the height grows to fit the images
+#define MAX_IMAGES 64
+
+/*
+Description: Image being packed and where it goes
+Author: Andrew Popa
+*/
+struct PackImage {
+    const char *pName;
+    FEHImage *pImage;
+    int x, y;
+};
+
+/*
+Description: Orders images tallest first, so each shelf wastes little height
+Input: Two images
+Output: Negative if a goes first
+Author: Andrew Popa
+*/
+int CompareHeight(const void *a, const void *b) {
+    const PackImage *pA = (const PackImage *)a, *pB = (const PackImage *)b;
+    if (pA->pImage->Height() != pB->pImage->Height())
+        return pB->pImage->Height() - pA->pImage->Height();
+    return pB->pImage->Width() - pA->pImage->Width();
+}
+
+/*
+Description: Returns the file name without its folders, which is the name the game asks for
+Input: Path
+Output: File name inside the path
+Author: Andrew Popa
+*/
+const char *BaseName(const char *pPath) {
+    const char *pSlash = strrchr(pPath, '/');
+    return pSlash ? pSlash + 1 : pPath;
+}
+
+/*
+Description: Packs the images on shelves: left to right until the row is full, then a new shelf below the tallest
+image of the row. Writes the atlas file
+Input: Output file name followed by the PNG files
+Output: 0 if the atlas was written
+Author: Andrew Popa
+*/
+int main(int argc, char *argv[]) {
+    if (argc < 3) {
+        fprintf(stderr, "usage: %s <atlas file> <png files>\n", argv[0]);
+        return 1;
+    }
+    PackImage images[MAX_IMAGES];
+    int count = 0;
+    for (int i = 2; i < argc && count < MAX_IMAGES; i++) {
+        if (strlen(BaseName(argv[i])) >= ATLAS_NAME_LENGTH) {
+            fprintf(stderr, "atlas: skipping %s, the name is too long\n", argv[i]);
+            continue;
+        }
+        FEHImage *pImage = new FEHImage(argv[i]);
+        if (pImage->Width() == 0 || pImage->Width() > ATLAS_WIDTH) {
+            fprintf(stderr, "atlas: skipping %s, it could not be loaded or is too wide\n", argv[i]);
+            delete pImage;
+            continue;
+        }
+        images[count].pName = BaseName(argv[i]);
+        images[count].pImage = pImage;
+        count++;
+    }
+    qsort(images, count, sizeof(PackImage), CompareHeight);
+
+    int x = 0, y = 0, shelfHeight = 0;
+    for (int i = 0; i < count; i++) {
+        FEHImage *pImage = images[i].pImage;
+        if (x + pImage->Width() > ATLAS_WIDTH) {
+            x = 0;
+            y += shelfHeight;
+            shelfHeight = 0;
+        }
+        images[i].x = x;
+        images[i].y = y;
+        x += pImage->Width();
+        if (pImage->Height() > shelfHeight)
+            shelfHeight = pImage->Height();
+    }
+    int height = y + shelfHeight;
+
+    //Copy the images in, with ATLAS_KEY for transparent pixels. Opaque pixels that happen to be ATLAS_KEY are
+    //changed by one bit of blue so they still draw
+    unsigned short *pPixels = new unsigned short[ATLAS_WIDTH * height];
+    for (int i = 0; i < ATLAS_WIDTH * height; i++)
+        pPixels[i] = ATLAS_KEY;
+    AtlasEntry *pEntries = new AtlasEntry[count];
+    memset(pEntries, 0, count * sizeof(AtlasEntry));
+    for (int i = 0; i < count; i++) {
+        FEHImage *pImage = images[i].pImage;
+        int w = pImage->Width(), h = pImage->Height();
+        bool bMasked = false;
+        for (int row = 0; row < h; row++)
+            for (int col = 0; col < w; col++) {
+                unsigned short pixel = pImage->Pixels()[row * w + col];
+                if (!pImage->Opaque()[row * w + col]) {
+                    pixel = ATLAS_KEY;
+                    bMasked = true;
+                } else if (pixel == ATLAS_KEY) {
+                    pixel ^= 1;
+                }
+                pPixels[(images[i].y + row) * ATLAS_WIDTH + images[i].x + col] = pixel;
+            }
+        strcpy(pEntries[i].name, images[i].pName);
+        pEntries[i].x = images[i].x;
+        pEntries[i].y = images[i].y;
+        pEntries[i].width = w;
+        pEntries[i].height = h;
+        pEntries[i].bMasked = bMasked;
+    }
+
+    AtlasHeader header;
+    memcpy(header.magic, "MDAT", 4);
+    header.version = ATLAS_VERSION;
+    header.width = ATLAS_WIDTH;
+    header.height = height;
+    header.count = count;
+    header.pixelOffset = (sizeof(AtlasHeader) + count * sizeof(AtlasEntry) + 15) & ~15u;
+    FILE *pFile = fopen(argv[1], "wb");
+    if (!pFile) {
+        fprintf(stderr, "atlas: could not write %s\n", argv[1]);
+        return 1;
+    }
+    char padding[16] = {0};
+    fwrite(&header, sizeof(header), 1, pFile);
+    fwrite(pEntries, sizeof(AtlasEntry), count, pFile);
+    fwrite(padding, 1, header.pixelOffset - sizeof(AtlasHeader) - count * sizeof(AtlasEntry), pFile);
+    fwrite(pPixels, sizeof(unsigned short), ATLAS_WIDTH * height, pFile);
+    bool bWritten = ferror(pFile) == 0;
+    fclose(pFile);
+    if (!bWritten) {
+        fprintf(stderr, "atlas: could not write %s\n", argv[1]);
+        return 1;
+    }
+    for (int i = 0; i < count; i++)
+        printf("%-24s %4d %4d %4d x %-4d%s\n", pEntries[i].name, pEntries[i].x, pEntries[i].y, pEntries[i].width,
+            pEntries[i].height, pEntries[i].bMasked ? " masked" : "");
+    printf("%s: %d images in %d x %d, %u KB\n", argv[1], count, ATLAS_WIDTH, height,
+        (unsigned int)((header.pixelOffset + ATLAS_WIDTH * height * 2) / 1024));
+
+    for (int i = 0; i < count; i++)
+        delete images[i].pImage;
+    delete[] pEntries;
+    delete[] pPixels;
+    return 0;
+}